@@ -0,0 +1,142 @@
+#include "AdaptiveTessellator.h"
+
+#include <algorithm>
+
+namespace {
+
+glm::vec2 project(const glm::vec4& point) {
+	return glm::vec2(point) / point.w;
+}
+
+float segmentDistance(glm::vec2 point, glm::vec2 start, glm::vec2 end) {
+	const glm::vec2 direction = end - start;
+	const float lengthSquared = glm::dot(direction, direction);
+	const float t = lengthSquared > 0 ? glm::clamp(glm::dot(point - start, direction) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+	return glm::distance(point, start + t * direction);
+}
+
+}
+
+void AdaptiveTessellator::tessellate(const Curve& curve, std::vector<glm::vec3>& vertices, std::vector<float>& parameters, std::pmr::memory_resource* scratch) const {
+	vertices.clear();
+	parameters.clear();
+	// Halves are released as soon as they are tessellated, the pool recycles them
+	std::pmr::unsynchronized_pool_resource pool(scratch);
+	scratch = &pool;
+	std::vector<glm::vec4> segments;
+	std::vector<float> breakpoints;
+	curve.decomposeBezier(segments, &breakpoints);
+	std::pmr::vector<glm::vec4> bezier(scratch);
+	for (size_t s = 0; s + 1 < breakpoints.size(); s++) {
+		bezier.assign(segments.begin() + s * curve.order, segments.begin() + (s + 1) * curve.order);
+		subdivide(bezier, breakpoints[s], breakpoints[s + 1], 0, vertices, parameters, scratch);
+	}
+	// Every piece emitted its start, the end of the curve closes the polyline
+	if (!bezier.empty()) {
+		vertices.push_back(glm::vec3(project(bezier.back()), 0));
+		parameters.push_back(breakpoints.back());
+	}
+}
+
+void AdaptiveTessellator::subdivide(const std::pmr::vector<glm::vec4>& bezier, float low, float high, int depth,
+	std::vector<glm::vec3>& vertices, std::vector<float>& parameters, std::pmr::memory_resource* scratch) const {
+	if (depth >= maxDepth || flat(bezier)) {
+		vertices.push_back(glm::vec3(project(bezier.front()), 0));
+		parameters.push_back(low);
+		return;
+	}
+	// de Casteljau at the midpoint, the left half is read off the first
+	// point of every level and the right half off the last
+	const int order = (int)bezier.size();
+	std::pmr::vector<glm::vec4> level(bezier, scratch);
+	std::pmr::vector<glm::vec4> left(order, scratch);
+	std::pmr::vector<glm::vec4> right(order, scratch);
+	left[0] = level[0];
+	right[order - 1] = level[order - 1];
+	for (int r = 1; r < order; r++) {
+		for (int i = 0; i < order - r; i++) {
+			level[i] = 0.5f * (level[i] + level[i + 1]);
+		}
+		left[r] = level[0];
+		right[order - 1 - r] = level[order - 1 - r];
+	}
+	const float middle = 0.5f * (low + high);
+	subdivide(left, low, middle, depth + 1, vertices, parameters, scratch);
+	subdivide(right, middle, high, depth + 1, vertices, parameters, scratch);
+}
+
+// The curve lies in the hull of its control points, so their distance from
+// the chord bounds the chord error. Polynomial pieces also have the tighter
+// bound p(p-1)/8 max|P[i-1] - 2P[i] + P[i+1]| on their distance from the chord.
+bool AdaptiveTessellator::flat(const std::pmr::vector<glm::vec4>& bezier) const {
+	const glm::vec2 start = project(bezier.front());
+	const glm::vec2 end = project(bezier.back());
+	float hullDistance = 0;
+	float secondDifference = 0;
+	bool polynomial = true;
+	for (size_t i = 1; i + 1 < bezier.size(); i++) {
+		hullDistance = std::max(hullDistance, segmentDistance(project(bezier[i]), start, end));
+		secondDifference = std::max(secondDifference, glm::length(project(bezier[i - 1]) - 2.0f * project(bezier[i]) + project(bezier[i + 1])));
+		polynomial = polynomial && bezier[i].w == bezier[0].w;
+	}
+	polynomial = polynomial && bezier.back().w == bezier[0].w;
+	const float degree = (float)bezier.size() - 1;
+	const float deviation = polynomial ? std::min(hullDistance, degree * (degree - 1) / 8 * secondDifference) : hullDistance;
+	return deviation <= tolerance;
+}
+
+// Checks a handful of points inside every chord, which is exact enough to compare tessellations
+float AdaptiveTessellator::chordError(const Curve& curve, const std::vector<float>& parameters) {
+	std::pmr::unsynchronized_pool_resource scratch;
+	const int checks = 8;
+	const int firstSpan = curve.order - 1;
+	const int lastSpan = (int)curve.controlPoints.size() - 1;
+	auto evaluate = [&](float u) {
+		u = std::min(u, curve.knots[lastSpan + 1] - 0.00001f);
+		const int delta = (int)(std::upper_bound(curve.knots.begin(), curve.knots.end(), u) - curve.knots.begin()) - 1;
+		return glm::vec2(curve.evaluate(glm::clamp(delta, firstSpan, lastSpan), u, &scratch));
+	};
+	float error = 0;
+	for (size_t i = 0; i + 1 < parameters.size(); i++) {
+		const float low = parameters[i];
+		const float high = parameters[i + 1];
+		const glm::vec2 start = evaluate(low);
+		const glm::vec2 stop = evaluate(high);
+		for (int k = 1; k < checks; k++) {
+			error = std::max(error, segmentDistance(evaluate(low + (high - low) * k / checks), start, stop));
+		}
+	}
+	return error;
+}
+
+// Doubles the step count until the error is met, then bisects back down
+int AdaptiveTessellator::uniformSegmentsFor(const Curve& curve, float maxError) {
+	const float start = curve.knots[curve.order - 1];
+	const float end = curve.knots[curve.controlPoints.size()];
+	std::vector<float> parameters;
+	auto errorWith = [&](int segments) {
+		parameters.resize(segments + 1);
+		for (int i = 0; i <= segments; i++) {
+			parameters[i] = start + (end - start) * i / segments;
+		}
+		return chordError(curve, parameters);
+	};
+	int high = 1;
+	while (errorWith(high) > maxError) {
+		if (high >= uniformLimit) {
+			return uniformLimit;
+		}
+		high *= 2;
+	}
+	int low = high / 2;
+	while (high - low > 1) {
+		const int middle = (low + high) / 2;
+		if (errorWith(middle) > maxError) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return high;
+}
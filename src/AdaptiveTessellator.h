@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory_resource>
+#include <vector>
+
+#include "Curve.h"
+
+// View independent tessellation for export and storage. Every segment of
+// decomposeBezier is split in half with de Casteljau until its projected
+// control polygon lies within tolerance of the chord. The curve stays inside
+// that polygon, so no chord strays further than tolerance.
+class AdaptiveTessellator {
+
+public:
+	float tolerance = 0.01f; // curve space units
+	int maxDepth = 20;
+
+	void tessellate(const Curve& curve, std::vector<glm::vec3>& vertices, std::vector<float>& parameters, std::pmr::memory_resource* scratch) const;
+
+	// Largest distance between the curve and a polyline through the given parameters
+	static float chordError(const Curve& curve, const std::vector<float>& parameters);
+	// Fewest uniform steps whose polyline is within maxError of the curve, or
+	// uniformLimit when even that many are not enough
+	static constexpr int uniformLimit = 1 << 20;
+	static int uniformSegmentsFor(const Curve& curve, float maxError);
+
+private:
+	void subdivide(const std::pmr::vector<glm::vec4>& bezier, float low, float high, int depth,
+		std::vector<glm::vec3>& vertices, std::vector<float>& parameters, std::pmr::memory_resource* scratch) const;
+	bool flat(const std::pmr::vector<glm::vec4>& bezier) const;
+};
@@ -0,0 +1,205 @@
+#include "ArcLengthTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+
+#include "Parallel.h"
+
+namespace {
+
+// Five point Gauss-Legendre rule on [-1, 1]
+const float gaussNodes[5] = { -0.9061798459f, -0.5384693101f, 0.0f, 0.5384693101f, 0.9061798459f };
+const float gaussWeights[5] = { 0.2369268851f, 0.4786286705f, 0.5688888889f, 0.4786286705f, 0.2369268851f };
+
+// Length of the first derivative of the rational curve in span delta
+float speed(const Curve& curve, int delta, float u, std::pmr::memory_resource* scratch) {
+	glm::vec3 derivatives[2];
+	curve.derivativesAt(delta, u, 1, derivatives, scratch);
+	return glm::length(derivatives[1]);
+}
+
+// Stack memory for the scratch of one query, only very high orders reach the heap
+struct QueryScratch {
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource resource{ buffer, sizeof(buffer) };
+};
+
+float integrate(const Curve& curve, int delta, float low, float high, std::pmr::memory_resource* scratch) {
+	const float half = 0.5f * (high - low);
+	const float middle = 0.5f * (high + low);
+	float sum = 0.0f;
+	for (int i = 0; i < 5; i++) {
+		sum += gaussWeights[i] * speed(curve, delta, middle + half * gaussNodes[i], scratch);
+	}
+	return sum * half;
+}
+
+}
+
+void ArcLengthTable::update(const Curve& curve) {
+	const bool valid = curve.controlPoints.size() >= curve.order && curve.knots.size() == curve.controlPoints.size() + curve.order;
+	if (!valid) {
+		clear();
+		return;
+	}
+	// New knots or a new point count move every span
+	if (curve.order != order || (int)curve.controlPoints.size() != pointCount || curve.knots != knots) {
+		order = curve.order;
+		pointCount = (int)curve.controlPoints.size();
+		knots = curve.knots;
+		spans.clear();
+		for (int delta = order - 1; delta < pointCount; delta++) {
+			if (knots[delta] < knots[delta + 1]) {
+				spans.push_back({ delta, knots[delta], knots[delta + 1], true });
+			}
+		}
+		spanLengths.assign(spans.size(), 0.0);
+		spanStarts.assign(spans.size() + 1, 0.0);
+		stepLengths.assign(spans.size() * (stepsPerSpan + 1), 0.0f);
+		stepSpeeds.assign(spans.size() * (stepsPerSpan + 1), 0.0f);
+		anyDirty = true;
+	}
+	if (!anyDirty) {
+		return;
+	}
+	anyDirty = false;
+
+	std::vector<int> dirty;
+	for (int s = 0; s < spans.size(); s++) {
+		if (spans[s].dirty) {
+			dirty.push_back(s);
+			spans[s].dirty = false;
+		}
+	}
+	spansRecomputed = (int)dirty.size();
+	parallelFor((int)dirty.size(), 16, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			measureSpan(curve, dirty[i]);
+		}
+	});
+	parallelExclusiveScan(spanLengths.data(), spanStarts.data(), (int)spans.size());
+	spanStarts.back() = spans.empty() ? 0.0 : spanStarts[spans.size() - 1] + spanLengths.back();
+}
+
+void ArcLengthTable::measureSpan(const Curve& curve, int span) {
+	QueryScratch scratch;
+	const Span& current = spans[span];
+	float* lengths = &stepLengths[span * (stepsPerSpan + 1)];
+	float* speeds = &stepSpeeds[span * (stepsPerSpan + 1)];
+	const float step = (current.end - current.start) / stepsPerSpan;
+	lengths[0] = 0.0f;
+	for (int i = 0; i <= stepsPerSpan; i++) {
+		const float u = current.start + i * step;
+		speeds[i] = speed(curve, current.delta, u, &scratch.resource);
+		if (i > 0) {
+			lengths[i] = lengths[i - 1] + integrate(curve, current.delta, u - step, u, &scratch.resource);
+		}
+	}
+	spanLengths[span] = lengths[stepsPerSpan];
+}
+
+// Every span control point pointIndex belongs to has to be measured again
+void ArcLengthTable::invalidate(int pointIndex) {
+	// Spans are laid out in increasing delta
+	auto span = std::lower_bound(spans.begin(), spans.end(), pointIndex, [](const Span& span, int delta) {
+		return span.delta < delta;
+	});
+	for (; span != spans.end() && span->delta < pointIndex + order; ++span) {
+		span->dirty = true;
+		anyDirty = true;
+	}
+}
+
+void ArcLengthTable::clear() {
+	spans.clear();
+	spanLengths.clear();
+	spanStarts.assign(1, 0.0);
+	stepLengths.clear();
+	stepSpeeds.clear();
+	knots.clear();
+	order = 0;
+	pointCount = 0;
+	anyDirty = false;
+}
+
+float ArcLengthTable::totalLength() const {
+	return spanStarts.empty() ? 0.0f : (float)spanStarts.back();
+}
+
+int ArcLengthTable::spanOf(float s) const {
+	const int span = (int)(std::upper_bound(spanStarts.begin(), spanStarts.end() - 1, (double)s) - spanStarts.begin()) - 1;
+	return glm::clamp(span, 0, (int)spans.size() - 1);
+}
+
+float ArcLengthTable::lengthAt(const Curve& curve, float u) const {
+	if (spans.empty()) {
+		return 0.0f;
+	}
+	QueryScratch scratch;
+	int span = (int)(std::upper_bound(spans.begin(), spans.end(), u, [](float value, const Span& s) { return value < s.start; }) - spans.begin()) - 1;
+	span = glm::clamp(span, 0, (int)spans.size() - 1);
+	const Span& current = spans[span];
+	u = glm::clamp(u, current.start, current.end);
+	const float step = (current.end - current.start) / stepsPerSpan;
+	const int node = std::min((int)((u - current.start) / step), stepsPerSpan - 1);
+	const float nodeU = current.start + node * step;
+	return (float)spanStarts[span] + stepLengths[span * (stepsPerSpan + 1) + node] + integrate(curve, current.delta, nodeU, u, &scratch.resource);
+}
+
+float ArcLengthTable::parameterAt(const Curve& curve, float s) const {
+	if (spans.empty()) {
+		return 0.0f;
+	}
+	QueryScratch scratch;
+	const int span = spanOf(s);
+	const Span& current = spans[span];
+	const float* lengths = &stepLengths[span * (stepsPerSpan + 1)];
+	const float* speeds = &stepSpeeds[span * (stepsPerSpan + 1)];
+	const float local = glm::clamp(s - (float)spanStarts[span], 0.0f, lengths[stepsPerSpan]);
+
+	// Table interval holding the length, always a short linear search
+	int node = 0;
+	while (node < stepsPerSpan - 1 && lengths[node + 1] < local) {
+		node++;
+	}
+	const float step = (current.end - current.start) / stepsPerSpan;
+	const float intervalLength = lengths[node + 1] - lengths[node];
+	if (intervalLength <= 0.0f) {
+		return current.start + node * step;
+	}
+
+	// Cubic Hermite for u(s) with slopes du/ds = 1/|C'|, limited so the
+	// interpolant can't overshoot the interval (Fritsch-Carlson)
+	const float t = (local - lengths[node]) / intervalLength;
+	const float secant = step / intervalLength;
+	auto slope = [&](float nodeSpeed) {
+		const float derivative = nodeSpeed > 0.0f ? 1.0f / nodeSpeed : secant;
+		return glm::clamp(derivative, 0.0f, 3.0f * secant);
+	};
+	const float m0 = slope(speeds[node]) * intervalLength;
+	const float m1 = slope(speeds[node + 1]) * intervalLength;
+	const float t2 = t * t;
+	const float t3 = t2 * t;
+	float u = current.start + node * step
+		+ (-2.0f * t3 + 3.0f * t2) * step
+		+ (t3 - 2.0f * t2 + t) * m0
+		+ (t3 - t2) * m1;
+
+	// One Newton step on length(u) - s, measured from the table node
+	const float nodeU = current.start + node * step;
+	const float error = lengths[node] + integrate(curve, current.delta, nodeU, u, &scratch.resource) - local;
+	const float derivative = speed(curve, current.delta, u, &scratch.resource);
+	if (derivative > 0.0f) {
+		u -= error / derivative;
+	}
+	return glm::clamp(u, nodeU, nodeU + step);
+}
+
+void ArcLengthTable::parametersAt(const Curve& curve, const float* lengths, float* parameters, int count) const {
+	parallelFor(count, 4096, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			parameters[i] = parameterAt(curve, lengths[i]);
+		}
+	});
+}
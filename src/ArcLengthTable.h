@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Curve.h"
+
+// Arc length of a curve tabulated per knot span. Every span is split into
+// equal parameter steps whose lengths come from Gauss-Legendre quadrature,
+// and the span lengths are joined with a prefix sum. Edits only recompute the
+// spans of the control points that moved.
+class ArcLengthTable {
+
+public:
+	static constexpr int stepsPerSpan = 8;
+
+	// Brings the table up to date, rebuilding everything if the knots changed
+	void update(const Curve& curve);
+	void invalidate(int pointIndex);
+	void clear();
+
+	float totalLength() const;
+	// Arc length from the start of the curve to u
+	float lengthAt(const Curve& curve, float u) const;
+	// Parameter where the arc length reaches s, through monotone cubic
+	// interpolation of the table followed by one Newton step
+	float parameterAt(const Curve& curve, float s) const;
+	// Many lookups at once, spread over the worker threads
+	void parametersAt(const Curve& curve, const float* lengths, float* parameters, int count) const;
+
+	int spansRecomputed = 0; // spans measured the last time anything was stale
+
+private:
+	struct Span {
+		int delta;
+		float start;
+		float end;
+		bool dirty;
+	};
+	std::vector<Span> spans;
+	std::vector<double> spanLengths;
+	std::vector<double> spanStarts;     // arc length where each span begins
+	std::vector<float> stepLengths;     // stepsPerSpan + 1 cumulative lengths per span
+	std::vector<float> stepSpeeds;      // |C'(u)| at the same nodes
+	std::vector<float> knots;           // knots the table was built for
+	int order = 0;
+	int pointCount = 0;
+	bool anyDirty = false;
+
+	void measureSpan(const Curve& curve, int span);
+	int spanOf(float s) const;
+};
@@ -0,0 +1,132 @@
+#include "BandMatrix.h"
+
+#include <algorithm>
+#include <cmath>
+
+void SymmetricBandMatrix::resize(int size, int bandwidth) {
+	n = size;
+	band = bandwidth;
+	entries.assign((size_t)size * (bandwidth + 1), 0.0);
+}
+
+int SymmetricBandMatrix::size() const {
+	return n;
+}
+
+int SymmetricBandMatrix::bandwidth() const {
+	return band;
+}
+
+double& SymmetricBandMatrix::at(int row, int column) {
+	return entries[(size_t)row * (band + 1) + row - column];
+}
+
+double SymmetricBandMatrix::at(int row, int column) const {
+	return entries[(size_t)row * (band + 1) + row - column];
+}
+
+bool SymmetricBandMatrix::factorize() {
+	for (int i = 0; i < n; i++) {
+		const int first = std::max(0, i - band);
+		for (int j = first; j <= i; j++) {
+			double sum = at(i, j);
+			for (int k = std::max(first, j - band); k < j; k++) {
+				sum -= at(i, k) * at(j, k);
+			}
+			if (j < i) {
+				at(i, j) = sum / at(j, j);
+			}
+			else if (sum > 0.0) {
+				at(i, i) = std::sqrt(sum);
+			}
+			else {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Forward substitution with L, then back substitution with L^T
+void SymmetricBandMatrix::solve(glm::dvec3* rhs) const {
+	for (int i = 0; i < n; i++) {
+		glm::dvec3 sum = rhs[i];
+		for (int k = std::max(0, i - band); k < i; k++) {
+			sum -= at(i, k) * rhs[k];
+		}
+		rhs[i] = sum / at(i, i);
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		glm::dvec3 sum = rhs[i];
+		for (int k = i + 1; k <= std::min(n - 1, i + band); k++) {
+			sum -= at(k, i) * rhs[k];
+		}
+		rhs[i] = sum / at(i, i);
+	}
+}
+
+void BandMatrix::resize(int size, int lower, int upper) {
+	n = size;
+	lowerBand = lower;
+	upperBand = upper;
+	entries.assign((size_t)size * (lower + upper + 1), 0.0);
+}
+
+int BandMatrix::size() const {
+	return n;
+}
+
+double& BandMatrix::at(int row, int column) {
+	return entries[(size_t)row * (lowerBand + upperBand + 1) + column - row + lowerBand];
+}
+
+double BandMatrix::at(int row, int column) const {
+	return entries[(size_t)row * (lowerBand + upperBand + 1) + column - row + lowerBand];
+}
+
+bool BandMatrix::factorize() {
+	for (int k = 0; k < n; k++) {
+		const double pivot = at(k, k);
+		if (pivot == 0.0) {
+			return false;
+		}
+		const int lastRow = std::min(n - 1, k + lowerBand);
+		const int lastColumn = std::min(n - 1, k + upperBand);
+		for (int i = k + 1; i <= lastRow; i++) {
+			const double factor = at(i, k) / pivot;
+			at(i, k) = factor;
+			if (factor == 0.0) {
+				continue;
+			}
+			for (int j = k + 1; j <= lastColumn; j++) {
+				at(i, j) -= factor * at(k, j);
+			}
+		}
+	}
+	return true;
+}
+
+template <typename T> void BandMatrix::substitute(T* rhs) const {
+	for (int i = 0; i < n; i++) {
+		T sum = rhs[i];
+		for (int k = std::max(0, i - lowerBand); k < i; k++) {
+			sum -= at(i, k) * rhs[k];
+		}
+		rhs[i] = sum;
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		T sum = rhs[i];
+		for (int k = i + 1; k <= std::min(n - 1, i + upperBand); k++) {
+			sum -= at(i, k) * rhs[k];
+		}
+		rhs[i] = sum / at(i, i);
+	}
+}
+
+void BandMatrix::solve(glm::dvec3* rhs) const {
+	substitute(rhs);
+}
+
+void BandMatrix::solve(double* rhs) const {
+	substitute(rhs);
+}
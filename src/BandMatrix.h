@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Symmetric matrix that is zero more than bandwidth entries off the
+// diagonal. Only the lower band is stored, row by row, so a matrix of size
+// n takes n * (bandwidth + 1) doubles. The normal equations of a B-spline
+// fit have bandwidth order - 1, since only order basis functions are non
+// zero at any parameter.
+class SymmetricBandMatrix {
+
+public:
+	void resize(int size, int bandwidth);
+	int size() const;
+	int bandwidth() const;
+
+	// Entry (row, column) for column in [row - bandwidth, row]
+	double& at(int row, int column);
+	double at(int row, int column) const;
+
+	// Cholesky factor L with A = L L^T in place, O(n * bandwidth^2). Fails
+	// when the matrix is not positive definite.
+	bool factorize();
+	// Solves A x = rhs with the factor, rhs is overwritten by x
+	void solve(glm::dvec3* rhs) const;
+
+private:
+	int n = 0;
+	int band = 0;
+	std::vector<double> entries;
+};
+
+// General band matrix with lower bandwidth lower and upper bandwidth upper,
+// row i stores columns i - lower .. i + upper. LU without pivoting keeps
+// the factors inside the band, which is safe for the collocation matrices
+// of B-spline interpolation since they are totally positive.
+class BandMatrix {
+
+public:
+	void resize(int size, int lower, int upper);
+	int size() const;
+
+	// Entry (row, column) for column in [row - lower, row + upper]
+	double& at(int row, int column);
+	double at(int row, int column) const;
+
+	// Unit lower L and upper U with A = L U in place, O(n * lower * upper).
+	// Fails on a zero pivot.
+	bool factorize();
+	// Solves A x = rhs with the factors, rhs is overwritten by x
+	void solve(glm::dvec3* rhs) const;
+	void solve(double* rhs) const;
+
+private:
+	int n = 0;
+	int lowerBand = 0;
+	int upperBand = 0;
+	std::vector<double> entries;
+
+	template <typename T> void substitute(T* rhs) const;
+};
@@ -0,0 +1,559 @@
+#include "Curve.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Curve::addControlPoint(glm::vec3 point, float weight) {
+	controlPoints.push_back(point);
+	weights.push_back(weight);
+}
+
+void Curve::insertControlPoint(int index, glm::vec3 point, float weight) {
+	controlPoints.insert(controlPoints.begin() + index, point);
+	weights.insert(weights.begin() + index, weight);
+}
+
+void Curve::removeControlPoint(int index) {
+	controlPoints.erase(controlPoints.begin() + index);
+	weights.erase(weights.begin() + index);
+}
+
+// Clamped knots, the curve starts and ends on its first and last control point
+void Curve::createStandardKnots() {
+	knots.clear();
+	for (int i = 0; i < order - 1; ++i) {
+		knots.push_back(0);
+	}
+	// Step with an integer so rounding can't drop the final knot
+	const int intervals = controlPoints.size() - order + 1;
+	for (int i = 0; i <= intervals; ++i) {
+		knots.push_back((float)i / (float)intervals);
+	}
+	for (int i = 0; i < order - 1; ++i)
+	{
+		knots.push_back(1);
+	}
+}
+
+void Curve::createUniformKnots() {
+	knots.clear();
+	const int intervals = controlPoints.size() + order - 1;
+	for (int i = 0; i <= intervals; ++i) {
+		knots.push_back((float)i / (float)intervals);
+	}
+}
+
+// Equal spacing up to the rounding of createUniformKnots
+bool Curve::hasUniformKnots() const {
+	if (knots.size() < 2) {
+		return false;
+	}
+	const float spacing = knots[1] - knots[0];
+	if (!(spacing > 0)) {
+		return false;
+	}
+	for (size_t i = 2; i < knots.size(); i++) {
+		if (std::abs(knots[i] - knots[i - 1] - spacing) > 1e-4f * spacing) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Curve::isClosed() const {
+	const int wrap = order - 1;
+	const int count = (int)controlPoints.size() - wrap;
+	if (count < order || knots.size() != controlPoints.size() + order || !hasUniformKnots()) {
+		return false;
+	}
+	for (int i = 0; i < wrap; i++) {
+		if (controlPoints[count + i] != controlPoints[i] || weights[count + i] != weights[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Repeats the first count points at the end, going round again when there are fewer
+void Curve::wrapPoints(int count) {
+	const int size = (int)controlPoints.size();
+	for (int i = 0; i < count && size > 0; i++) {
+		controlPoints.push_back(controlPoints[i % size]);
+		weights.push_back(weights[i % size]);
+	}
+}
+
+void Curve::unwrapPoints(int count) {
+	count = std::min(std::max(count, 0), (int)controlPoints.size());
+	controlPoints.resize(controlPoints.size() - count);
+	weights.resize(weights.size() - count);
+}
+
+// Index of the knot span containing uValue, -1 if there is none. Only the
+// spans of the domain count, unclamped knots have more outside of it, so
+// uValue is clamped into the domain first.
+int Curve::computeDelta(float &uValue) const {
+	if ((int)controlPoints.size() < order || knots.size() != controlPoints.size() + order) {
+		return -1;
+	}
+	const float low = knots[order - 1];
+	const float high = knots[controlPoints.size()];
+	if (uValue >= high) {
+		uValue = high - 0.00001f;
+	}
+	if (uValue < low) {
+		uValue = low;
+	}
+	for (int i = order - 1; i < (int)controlPoints.size(); ++i)
+	{
+		if(uValue>=knots[i] && uValue<knots[i+1]){
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Weighted de Boor recursion, the result still has to be divided by the weight
+glm::vec3 Curve::deBoorAlg(int delta, float uValue, std::pmr::memory_resource* scratch) const {
+	std::pmr::vector<glm::vec3> contributorPoints(scratch);
+	contributorPoints.reserve(order);
+	for (int i = 0; i < order; i++)
+	{
+		contributorPoints.push_back(controlPoints[delta - i]*weights[delta-i]);
+	}
+
+	for (int r = order; r >= 2; r--)
+	{
+		int i = delta;
+		for (int s = 0; s <= r-2; s++)
+		{
+			float omega = (uValue - knots[i]) / (knots[i + r - 1] - knots[i]);
+			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
+			i--;
+		}
+	}
+
+	return contributorPoints[0];
+}
+
+float Curve::deBoorAlgWeightsOnly(int delta, float uValue, std::pmr::memory_resource* scratch) const {
+	std::pmr::vector<float> contributorPoints(scratch);
+	contributorPoints.reserve(order);
+	for (int i = 0; i < order; i++)
+	{
+		contributorPoints.push_back(weights[delta - i]);
+	}
+
+	for (int r = order; r >= 2; r--)
+	{
+		int i = delta;
+		for (int s = 0; s <= r - 2; s++)
+		{
+			float omega = (uValue - knots[i]) / (knots[i + r - 1] - knots[i]);
+			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
+			i--;
+		}
+	}
+
+	return contributorPoints[0];
+}
+
+// Point on the curve at uValue, which must lie in knot span delta
+glm::vec3 Curve::evaluate(int delta, float uValue, std::pmr::memory_resource* scratch) const {
+	return deBoorAlg(delta, uValue, scratch) / deBoorAlgWeightsOnly(delta, uValue, scratch);
+}
+
+// de Boor's recursion with a separate parameter per level, which evaluates the
+// blossom of span delta in homogeneous coordinates. arguments holds order-1 values.
+glm::vec4 Curve::blossom(int delta, const float* arguments, std::pmr::memory_resource* scratch) const {
+	std::pmr::vector<glm::vec4> contributorPoints(scratch);
+	contributorPoints.reserve(order);
+	for (int i = 0; i < order; i++)
+	{
+		contributorPoints.emplace_back(controlPoints[delta - i] * weights[delta - i], weights[delta - i]);
+	}
+
+	for (int r = order; r >= 2; r--)
+	{
+		const float uValue = arguments[order - r];
+		int i = delta;
+		for (int s = 0; s <= r - 2; s++)
+		{
+			float omega = (uValue - knots[i]) / (knots[i + r - 1] - knots[i]);
+			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
+			i--;
+		}
+	}
+
+	return contributorPoints[0];
+}
+
+// Bezier point j of a span is the blossom at (a, ..., a, b, ..., b) with j copies of b
+void Curve::spanBezier(int delta, std::pmr::vector<glm::vec4>& bezier) const {
+	const int degree = order - 1;
+	std::pmr::vector<float> arguments(degree, bezier.get_allocator().resource());
+	bezier.resize(order);
+	for (int j = 0; j <= degree; j++) {
+		for (int k = 0; k < degree; k++) {
+			arguments[k] = k < degree - j ? knots[delta] : knots[delta + 1];
+		}
+		bezier[j] = blossom(delta, arguments.data(), bezier.get_allocator().resource());
+	}
+}
+
+std::vector<glm::vec4> Curve::homogeneousPoints() const {
+	std::vector<glm::vec4> points(controlPoints.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		points[i] = glm::vec4(controlPoints[i] * weights[i], weights[i]);
+	}
+	return points;
+}
+
+void Curve::setHomogeneousPoints(const std::vector<glm::vec4>& points) {
+	controlPoints.resize(points.size());
+	weights.resize(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		weights[i] = points[i].w;
+		controlPoints[i] = glm::vec3(points[i]) / points[i].w;
+	}
+}
+
+// Knot span of uValue within the domain [knots[order-1], knots[n+1]], by
+// binary search (NURBS book A2.1). The end of the domain belongs to the last span.
+int Curve::findSpan(float uValue) const {
+	const int degree = order - 1;
+	const int last = (int)controlPoints.size() - 1;
+	if (uValue >= knots[last + 1]) {
+		return last;
+	}
+	if (uValue <= knots[degree]) {
+		return degree;
+	}
+	return (int)(std::upper_bound(knots.begin() + degree, knots.begin() + last + 1, uValue) - knots.begin()) - 1;
+}
+
+int Curve::knotMultiplicity(float uValue) const {
+	return (int)std::count(knots.begin(), knots.end(), uValue);
+}
+
+// Boehm's algorithm (NURBS book A5.1), inserts uValue the given number of
+// times in O(order * times). Fails when the knot would exceed multiplicity
+// order-1 or lies outside the domain; the end of the domain is left out,
+// findSpan puts it in the last span, before the knot it would add to.
+bool Curve::insertKnot(float uValue, int times) {
+	const int degree = order - 1;
+	const int last = (int)controlPoints.size() - 1;
+	if (times <= 0 || controlPoints.size() < order || uValue < knots[degree] || uValue >= knots[last + 1]) {
+		return false;
+	}
+	const int span = findSpan(uValue);
+	const int multiplicity = knotMultiplicity(uValue);
+	if (times + multiplicity > degree) {
+		return false;
+	}
+
+	const std::vector<glm::vec4> points = homogeneousPoints();
+	std::vector<glm::vec4> inserted(points.size() + times);
+	std::vector<float> newKnots(knots.size() + times);
+	for (int i = 0; i <= span; i++) {
+		newKnots[i] = knots[i];
+	}
+	for (int i = 1; i <= times; i++) {
+		newKnots[span + i] = uValue;
+	}
+	for (int i = span + 1; i < knots.size(); i++) {
+		newKnots[i + times] = knots[i];
+	}
+	// Points away from the span are only shifted
+	for (int i = 0; i <= span - degree; i++) {
+		inserted[i] = points[i];
+	}
+	for (int i = span - multiplicity; i <= last; i++) {
+		inserted[i + times] = points[i];
+	}
+	std::vector<glm::vec4> affected(points.begin() + span - degree, points.begin() + span - multiplicity + 1);
+	int lowest = 0;
+	for (int j = 1; j <= times; j++) {
+		lowest = span - degree + j;
+		for (int i = 0; i <= degree - j - multiplicity; i++) {
+			const float alpha = (uValue - knots[lowest + i]) / (knots[i + span + 1] - knots[lowest + i]);
+			affected[i] = alpha * affected[i + 1] + (1.0f - alpha) * affected[i];
+		}
+		inserted[lowest] = affected[0];
+		inserted[span + times - j - multiplicity] = affected[degree - j - multiplicity];
+	}
+	for (int i = lowest + 1; i < span - multiplicity; i++) {
+		inserted[i] = affected[i - lowest];
+	}
+
+	knots.swap(newKnots);
+	setHomogeneousPoints(inserted);
+	return true;
+}
+
+// Inserts a whole sorted list of knots in one pass (NURBS book A5.4), which is
+// linear in the size of the result instead of one Boehm step per knot.
+void Curve::refineKnots(const std::vector<float>& newKnots) {
+	const int degree = order - 1;
+	const int last = (int)controlPoints.size() - 1;
+	if (newKnots.empty() || controlPoints.size() < order) {
+		return;
+	}
+	const int count = (int)newKnots.size();
+	const int lastKnot = last + order;
+	const int a = findSpan(newKnots.front());
+	const int b = findSpan(newKnots.back()) + 1;
+
+	const std::vector<glm::vec4> points = homogeneousPoints();
+	std::vector<glm::vec4> refined(points.size() + count);
+	std::vector<float> refinedKnots(knots.size() + count);
+	for (int j = 0; j <= a - degree; j++) {
+		refined[j] = points[j];
+	}
+	for (int j = b - 1; j <= last; j++) {
+		refined[j + count] = points[j];
+	}
+	for (int j = 0; j <= a; j++) {
+		refinedKnots[j] = knots[j];
+	}
+	for (int j = b + degree; j <= lastKnot; j++) {
+		refinedKnots[j + count] = knots[j];
+	}
+
+	// Work down from the end, each new knot only touches degree points
+	int i = b + degree - 1;
+	int k = b + degree + count - 1;
+	for (int j = count - 1; j >= 0; j--) {
+		while (newKnots[j] <= knots[i] && i > a) {
+			refined[k - degree - 1] = points[i - degree - 1];
+			refinedKnots[k] = knots[i];
+			k--;
+			i--;
+		}
+		refined[k - degree - 1] = refined[k - degree];
+		for (int l = 1; l <= degree; l++) {
+			const int index = k - degree + l;
+			float alpha = refinedKnots[k + l] - newKnots[j];
+			if (alpha == 0.0f) {
+				refined[index - 1] = refined[index];
+			}
+			else {
+				alpha = alpha / (refinedKnots[k + l] - knots[i - degree + l]);
+				refined[index - 1] = alpha * refined[index - 1] + (1.0f - alpha) * refined[index];
+			}
+		}
+		refinedKnots[k] = newKnots[j];
+		k--;
+	}
+
+	knots.swap(refinedKnots);
+	setHomogeneousPoints(refined);
+}
+
+// Bezier segments of every non-empty span in a single sweep (NURBS book A5.6).
+// That needs clamped ends, other knot vectors go through the blossom per span.
+void Curve::decomposeBezier(std::vector<glm::vec4>& bezier, std::vector<float>* breakpoints) const {
+	const int degree = order - 1;
+	const int last = (int)controlPoints.size() - 1;
+	bezier.clear();
+	if (breakpoints) {
+		breakpoints->clear();
+	}
+	if (controlPoints.size() < order || knots.size() != controlPoints.size() + order) {
+		return;
+	}
+	const int lastKnot = last + order;
+	bool clamped = true;
+	for (int i = 1; i < order; i++) {
+		clamped = clamped && knots[i] == knots[0] && knots[lastKnot - i] == knots[lastKnot];
+	}
+	if (breakpoints) {
+		breakpoints->push_back(knots[degree]);
+		for (int delta = degree; delta <= last; delta++) {
+			if (knots[delta] < knots[delta + 1]) {
+				breakpoints->push_back(knots[delta + 1]);
+			}
+		}
+	}
+	if (!clamped) {
+		std::pmr::vector<glm::vec4> span(std::pmr::new_delete_resource());
+		for (int delta = degree; delta <= last; delta++) {
+			if (knots[delta] < knots[delta + 1]) {
+				spanBezier(delta, span);
+				bezier.insert(bezier.end(), span.begin(), span.end());
+			}
+		}
+		return;
+	}
+
+	const std::vector<glm::vec4> points = homogeneousPoints();
+	std::vector<float> alphas(order);
+	// The segment being finished and the start of the next one
+	std::vector<glm::vec4> current(points.begin(), points.begin() + order);
+	std::vector<glm::vec4> next(order);
+	int a = degree;
+	int b = order;
+	while (b < lastKnot) {
+		const int i = b;
+		while (b < lastKnot && knots[b + 1] == knots[b]) {
+			b++;
+		}
+		const int multiplicity = b - i + 1;
+		// Raise the interior knot to full multiplicity to split off a segment
+		if (multiplicity < degree) {
+			const float numerator = knots[b] - knots[a];
+			for (int j = degree; j > multiplicity; j--) {
+				alphas[j - multiplicity - 1] = numerator / (knots[a + j] - knots[a]);
+			}
+			const int r = degree - multiplicity;
+			for (int j = 1; j <= r; j++) {
+				const int save = r - j;
+				const int s = multiplicity + j;
+				for (int k = degree; k >= s; k--) {
+					const float alpha = alphas[k - s];
+					current[k] = alpha * current[k] + (1.0f - alpha) * current[k - 1];
+				}
+				if (b < lastKnot) {
+					next[save] = current[degree];
+				}
+			}
+		}
+		bezier.insert(bezier.end(), current.begin(), current.end());
+		if (b < lastKnot) {
+			for (int j = std::max(degree - multiplicity, 0); j <= degree; j++) {
+				next[j] = points[b - degree + j];
+			}
+			current.swap(next);
+			a = b;
+			b++;
+		}
+	}
+}
+
+glm::vec3 CurveDerivatives::at(int derivative, int sample) const {
+	const int index = derivative * count + sample;
+	return glm::vec3(x[index], y[index], z[index]);
+}
+
+void Curve::basisDerivatives(int delta, float uValue, int n, float* ders, std::pmr::memory_resource* scratch) const {
+	const int degree = order - 1;
+	const int computed = std::min(n, degree);
+	// ndu holds the basis functions in its upper triangle and knot differences below
+	std::pmr::vector<float> ndu(order * order, scratch);
+	std::pmr::vector<float> left(order, scratch);
+	std::pmr::vector<float> right(order, scratch);
+	std::pmr::vector<float> a(2 * order, scratch);
+	auto at = [&](int row, int column) -> float& { return ndu[row * order + column]; };
+
+	at(0, 0) = 1.0f;
+	for (int j = 1; j <= degree; j++) {
+		left[j] = uValue - knots[delta + 1 - j];
+		right[j] = knots[delta + j] - uValue;
+		float saved = 0.0f;
+		for (int r = 0; r < j; r++) {
+			at(j, r) = right[r + 1] + left[j - r];
+			const float temp = at(r, j - 1) / at(j, r);
+			at(r, j) = saved + right[r + 1] * temp;
+			saved = left[j - r] * temp;
+		}
+		at(j, j) = saved;
+	}
+	for (int j = 0; j <= degree; j++) {
+		ders[j] = at(j, degree);
+	}
+
+	for (int r = 0; r <= degree; r++) {
+		float* previous = &a[0];
+		float* current = &a[order];
+		previous[0] = 1.0f;
+		for (int k = 1; k <= computed; k++) {
+			float d = 0.0f;
+			const int rk = r - k;
+			const int pk = degree - k;
+			if (r >= k) {
+				current[0] = previous[0] / at(pk + 1, rk);
+				d = current[0] * at(rk, pk);
+			}
+			const int j1 = rk >= -1 ? 1 : -rk;
+			const int j2 = r - 1 <= pk ? k - 1 : degree - r;
+			for (int j = j1; j <= j2; j++) {
+				current[j] = (previous[j] - previous[j - 1]) / at(pk + 1, rk + j);
+				d += current[j] * at(rk + j, pk);
+			}
+			if (r <= pk) {
+				current[k] = -previous[k - 1] / at(pk + 1, r);
+				d += current[k] * at(r, pk);
+			}
+			ders[k * order + r] = d;
+			std::swap(previous, current);
+		}
+	}
+
+	float factor = (float)degree;
+	for (int k = 1; k <= computed; k++) {
+		for (int j = 0; j <= degree; j++) {
+			ders[k * order + j] *= factor;
+		}
+		factor *= (float)(degree - k);
+	}
+	// A polynomial of degree p has no derivatives past p
+	std::fill(ders + (computed + 1) * order, ders + (n + 1) * order, 0.0f);
+}
+
+void Curve::derivativesAt(int delta, float uValue, int n, glm::vec3* derivatives, std::pmr::memory_resource* scratch) const {
+	std::pmr::vector<float> ders((n + 1) * order, scratch);
+	std::pmr::vector<glm::vec4> homogeneous(n + 1, scratch);
+	basisDerivatives(delta, uValue, n, ders.data(), scratch);
+
+	// Derivatives of the weighted point and of the weight in one sweep
+	for (int k = 0; k <= n; k++) {
+		glm::vec4 sum(0.0f);
+		for (int j = 0; j < order; j++) {
+			const int point = delta - order + 1 + j;
+			sum += ders[k * order + j] * glm::vec4(controlPoints[point] * weights[point], weights[point]);
+		}
+		homogeneous[k] = sum;
+	}
+	// Quotient rule (NURBS book A4.2)
+	for (int k = 0; k <= n; k++) {
+		glm::vec3 value = glm::vec3(homogeneous[k]);
+		float binomial = 1.0f;
+		for (int j = 1; j <= k; j++) {
+			binomial = binomial * (float)(k - j + 1) / (float)j;
+			value -= binomial * homogeneous[j].w * derivatives[k - j];
+		}
+		derivatives[k] = value / homogeneous[0].w;
+	}
+}
+
+void Curve::evaluateDerivatives(const float* parameters, int count, int derivatives, CurveDerivatives& result, std::pmr::memory_resource* scratch) const {
+	const int size = (derivatives + 1) * count;
+	result.count = count;
+	result.derivatives = derivatives;
+	result.x.resize(size);
+	result.y.resize(size);
+	result.z.resize(size);
+	result.curvature.resize(derivatives >= 2 ? count : 0);
+	if (controlPoints.size() < order || knots.size() != controlPoints.size() + order) {
+		return;
+	}
+
+	// Per sample scratch is released right away, the pool hands it out again
+	std::pmr::unsynchronized_pool_resource pool(scratch);
+	std::pmr::vector<glm::vec3> cartesian(derivatives + 1, &pool);
+	for (int i = 0; i < count; i++) {
+		const float uValue = parameters[i];
+		derivativesAt(findSpan(uValue), uValue, derivatives, cartesian.data(), &pool);
+		for (int k = 0; k <= derivatives; k++) {
+			result.x[k * count + i] = cartesian[k].x;
+			result.y[k * count + i] = cartesian[k].y;
+			result.z[k * count + i] = cartesian[k].z;
+		}
+		if (derivatives >= 2) {
+			const glm::vec3 first = cartesian[1];
+			const glm::vec3 second = cartesian[2];
+			const float speed = glm::length(glm::vec2(first));
+			result.curvature[i] = speed > 0.0f ? (first.x * second.y - first.y * second.x) / (speed * speed * speed) : 0.0f;
+		}
+	}
+}
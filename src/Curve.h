@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory_resource>
+#include <vector>
+
+// Positions and derivatives of a batch of samples as a structure of arrays.
+// Derivative k of sample i is stored at index k * count + i.
+struct CurveDerivatives {
+	int count = 0;
+	int derivatives = 0;
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> curvature; // signed curvature in the xy plane, when derivatives >= 2
+
+	glm::vec3 at(int derivative, int sample) const;
+};
+
+// Authoritative data of a NURBS curve. Render geometry only views this
+// storage, it never keeps its own copy of the control points.
+class Curve {
+
+public:
+	int order = 2;
+	std::vector<glm::vec3> controlPoints;
+	std::vector<float> weights;
+	std::vector<float> knots;
+
+	void addControlPoint(glm::vec3 point, float weight = 1);
+	void insertControlPoint(int index, glm::vec3 point, float weight = 1);
+	void removeControlPoint(int index);
+
+	// Knot vector generation
+	void createStandardKnots();
+	void createUniformKnots();
+	bool hasUniformKnots() const;
+
+	// A closed curve repeats its first order-1 control points at the end and
+	// has uniform knots, which makes it periodic over its domain
+	bool isClosed() const;
+	void wrapPoints(int count);
+	void unwrapPoints(int count);
+
+	// Evaluation, scratch space comes from the given memory resource
+	int computeDelta(float &uValue) const;
+	glm::vec3 deBoorAlg(int delta, float uValue, std::pmr::memory_resource* scratch) const;
+	float deBoorAlgWeightsOnly(int delta, float uValue, std::pmr::memory_resource* scratch) const;
+	glm::vec3 evaluate(int delta, float uValue, std::pmr::memory_resource* scratch) const;
+
+	// Basis functions of span delta and their first n derivatives (NURBS book
+	// A2.3). ders[k * order + j] is derivative k of basis function delta-order+1+j.
+	void basisDerivatives(int delta, float uValue, int n, float* ders, std::pmr::memory_resource* scratch) const;
+	// Position and derivatives 1..n of the rational curve at one parameter of span delta
+	void derivativesAt(int delta, float uValue, int n, glm::vec3* derivatives, std::pmr::memory_resource* scratch) const;
+	// Position and the first derivatives at every parameter, rational curves
+	// through the quotient rule. The basis is shared by all derivatives.
+	void evaluateDerivatives(const float* parameters, int count, int derivatives, CurveDerivatives& result, std::pmr::memory_resource* scratch) const;
+
+	// Span delta in rational Bezier form, homogeneous points (x*w, y*w, z*w, w)
+	glm::vec4 blossom(int delta, const float* arguments, std::pmr::memory_resource* scratch) const;
+	void spanBezier(int delta, std::pmr::vector<glm::vec4>& bezier) const;
+
+	// Control points as (x*w, y*w, z*w, w) and back
+	std::vector<glm::vec4> homogeneousPoints() const;
+	void setHomogeneousPoints(const std::vector<glm::vec4>& points);
+
+	// Changes of representation that leave the shape of the curve alone.
+	// Knots go in with their parameter, the order and domain stay the same.
+	int findSpan(float uValue) const;
+	int knotMultiplicity(float uValue) const;
+	bool insertKnot(float uValue, int times = 1);
+	void refineKnots(const std::vector<float>& newKnots);
+	// Every span as order homogeneous Bezier points, one segment after another
+	void decomposeBezier(std::vector<glm::vec4>& bezier, std::vector<float>* breakpoints = nullptr) const;
+};
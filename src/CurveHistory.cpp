@@ -0,0 +1,95 @@
+#include "CurveHistory.h"
+
+size_t CurveSnapshot::bytesAllocated() const {
+	return sizeof(CurveSnapshot) + controlPoints.bytesAllocated() + weights.bytesAllocated() + knots.bytesAllocated();
+}
+
+void CurveSnapshot::restore(Curve& curve) const {
+	curve.order = order;
+	controlPoints.copyTo(curve.controlPoints);
+	weights.copyTo(curve.weights);
+	knots.copyTo(curve.knots);
+}
+
+// Records the curve as a new entry, dropping anything that could be redone.
+// Returns false if nothing changed since the current entry.
+bool CurveHistory::commit(const Curve& curve) {
+	std::shared_ptr<CurveSnapshot> snapshot = std::make_shared<CurveSnapshot>();
+	const CurveSnapshot empty = CurveSnapshot();
+	const CurveSnapshot& previous = current >= 0 ? *entries[current] : empty;
+	snapshot->order = curve.order;
+	snapshot->controlPoints = PersistentArray<glm::vec3>::fromVector(curve.controlPoints, previous.controlPoints);
+	snapshot->weights = PersistentArray<float>::fromVector(curve.weights, previous.weights);
+	snapshot->knots = PersistentArray<float>::fromVector(curve.knots, previous.knots);
+
+	// Every chunk was shared, so the curve is identical to the current entry
+	if (current >= 0 && snapshot->order == previous.order &&
+		snapshot->controlPoints.size() == previous.controlPoints.size() && snapshot->controlPoints.bytesAllocated() == 0 &&
+		snapshot->weights.size() == previous.weights.size() && snapshot->weights.bytesAllocated() == 0 &&
+		snapshot->knots.size() == previous.knots.size() && snapshot->knots.bytesAllocated() == 0) {
+		return false;
+	}
+
+	entries.resize(current + 1);
+	entries.push_back(snapshot);
+	current++;
+	publish();
+	return true;
+}
+
+bool CurveHistory::undo(Curve& curve) {
+	if (!canUndo()) {
+		return false;
+	}
+	current--;
+	entries[current]->restore(curve);
+	publish();
+	return true;
+}
+
+bool CurveHistory::redo(Curve& curve) {
+	if (!canRedo()) {
+		return false;
+	}
+	current++;
+	entries[current]->restore(curve);
+	publish();
+	return true;
+}
+
+bool CurveHistory::canUndo() const {
+	return current > 0;
+}
+
+bool CurveHistory::canRedo() const {
+	return current + 1 < entries.size();
+}
+
+int CurveHistory::size() const {
+	return entries.size();
+}
+
+int CurveHistory::position() const {
+	return current;
+}
+
+// Memory an entry added on top of the one before it
+size_t CurveHistory::entryBytes(int entry) const {
+	return entries[entry]->bytesAllocated();
+}
+
+size_t CurveHistory::totalBytes() const {
+	size_t total = 0;
+	for (const std::shared_ptr<const CurveSnapshot>& entry : entries) {
+		total += entry->bytesAllocated();
+	}
+	return total;
+}
+
+std::shared_ptr<const CurveSnapshot> CurveHistory::latest() const {
+	return std::atomic_load(&published);
+}
+
+void CurveHistory::publish() {
+	std::atomic_store(&published, entries[current]);
+}
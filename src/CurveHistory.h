@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "Curve.h"
+#include "PersistentArray.h"
+
+// Immutable state of a curve at one point in its edit history
+struct CurveSnapshot {
+	int order;
+	PersistentArray<glm::vec3> controlPoints;
+	PersistentArray<float> weights;
+	PersistentArray<float> knots;
+
+	size_t bytesAllocated() const;
+	void restore(Curve& curve) const;
+};
+
+// Undo/redo stack of curve snapshots sharing unchanged chunks with each other
+class CurveHistory {
+
+public:
+	bool commit(const Curve& curve);
+	bool undo(Curve& curve);
+	bool redo(Curve& curve);
+
+	bool canUndo() const;
+	bool canRedo() const;
+	int size() const;
+	int position() const;
+	size_t entryBytes(int entry) const;
+	size_t totalBytes() const;
+
+	// Snapshot of the current state that worker threads can read freely
+	std::shared_ptr<const CurveSnapshot> latest() const;
+
+private:
+	std::vector<std::shared_ptr<const CurveSnapshot>> entries;
+	int current = -1;
+	std::shared_ptr<const CurveSnapshot> published;
+
+	void publish();
+};
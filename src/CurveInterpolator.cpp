@@ -0,0 +1,132 @@
+#include "CurveInterpolator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+
+namespace {
+
+// Entries of the inverse column below this share of its largest entry are dropped
+const double influenceCutoff = 1e-7;
+
+}
+
+int CurveInterpolator::pointCount() const {
+	return (int)points.size();
+}
+
+glm::vec3 CurveInterpolator::controlPoint(int index) const {
+	return glm::vec3(solution[index]);
+}
+
+bool CurveInterpolator::interpolate(const std::vector<glm::vec3>& points, int order, Curve& curve) {
+	const int count = (int)points.size();
+	const int degree = order - 1;
+	influenceIndex = -1;
+	this->points.clear();
+	if (order < 2 || count < order) {
+		return false;
+	}
+
+	// Parameters from the distances between neighbours
+	parameters.assign(count, 0.0f);
+	std::vector<double> travelled(count, 0.0);
+	for (int k = 1; k < count; k++) {
+		const double distance = glm::distance(points[k - 1], points[k]);
+		if (distance == 0.0) {
+			return false;
+		}
+		travelled[k] = travelled[k - 1] + (parameterization == Parameterization::Centripetal ? std::sqrt(distance) : distance);
+	}
+	for (int k = 1; k < count; k++) {
+		parameters[k] = (float)(travelled[k] / travelled.back());
+	}
+	parameters.back() = 1.0f;
+
+	// Every interior knot averages degree parameters (NURBS book 9.8)
+	shape = Curve();
+	shape.order = order;
+	shape.controlPoints.assign(count, glm::vec3(0));
+	shape.weights.assign(count, 1.0f);
+	shape.knots.assign(count + order, 0.0f);
+	for (int j = 1; j < count - degree; j++) {
+		double sum = 0.0;
+		for (int i = j; i < j + degree; i++) {
+			sum += parameters[i];
+		}
+		shape.knots[j + degree] = (float)(sum / degree);
+	}
+	for (int j = count; j < count + order; j++) {
+		shape.knots[j] = 1.0f;
+	}
+
+	// Row k holds the basis functions at parameter k, the band follows from the spans
+	std::pmr::unsynchronized_pool_resource pool;
+	std::vector<int> spans(count);
+	int lower = 0;
+	int upper = 0;
+	for (int k = 0; k < count; k++) {
+		spans[k] = shape.findSpan(parameters[k]);
+		lower = std::max(lower, k - (spans[k] - degree));
+		upper = std::max(upper, spans[k] - k);
+	}
+	collocation.resize(count, lower, upper);
+	std::vector<float> basis(order);
+	for (int k = 0; k < count; k++) {
+		shape.basisDerivatives(spans[k], parameters[k], 0, basis.data(), &pool);
+		for (int a = 0; a < order; a++) {
+			collocation.at(k, spans[k] - degree + a) = basis[a];
+		}
+	}
+	if (!collocation.factorize()) {
+		return false;
+	}
+	solution.resize(count);
+	for (int k = 0; k < count; k++) {
+		solution[k] = glm::dvec3(points[k]);
+	}
+	collocation.solve(solution.data());
+
+	this->points = points;
+	curve.order = order;
+	curve.knots = shape.knots;
+	curve.weights = shape.weights;
+	curve.controlPoints.resize(count);
+	for (int k = 0; k < count; k++) {
+		curve.controlPoints[k] = glm::vec3(solution[k]);
+	}
+	return true;
+}
+
+bool CurveInterpolator::movePoint(int index, glm::vec3 position, int& first, int& last) {
+	if (index < 0 || index >= (int)points.size()) {
+		return false;
+	}
+	// One solve with a unit right hand side when a different point is grabbed
+	if (index != influenceIndex) {
+		influence.assign(points.size(), 0.0);
+		influence[index] = 1.0;
+		collocation.solve(influence.data());
+		double largest = 0.0;
+		for (double value : influence) {
+			largest = std::max(largest, std::abs(value));
+		}
+		influenceFirst = index;
+		influenceLast = index;
+		for (int i = 0; i < (int)influence.size(); i++) {
+			if (std::abs(influence[i]) > influenceCutoff * largest) {
+				influenceFirst = std::min(influenceFirst, i);
+				influenceLast = std::max(influenceLast, i);
+			}
+		}
+		influenceIndex = index;
+	}
+	const glm::dvec3 offset = glm::dvec3(position) - glm::dvec3(points[index]);
+	points[index] = position;
+	for (int i = influenceFirst; i <= influenceLast; i++) {
+		solution[i] += influence[i] * offset;
+	}
+	first = influenceFirst;
+	last = influenceLast;
+	return true;
+}
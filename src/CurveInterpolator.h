@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "BandMatrix.h"
+#include "Curve.h"
+
+// How the points are spread over the parameter range
+enum class Parameterization {
+	ChordLength, // proportional to the distance between points
+	Centripetal  // proportional to its square root, tighter around sharp turns
+};
+
+// Global interpolation (NURBS book 9.2.1): a curve through every point,
+// one control point per data point, knots averaged from the parameters.
+// The collocation matrix has a band as wide as the order and is factored
+// once. Moving a single point changes only the right hand side, so the
+// control points follow by one column of the inverse scaled by the move.
+// That column falls off quickly away from the point and is cut off where
+// it no longer matters, so a drag only touches a few control points.
+class CurveInterpolator {
+
+public:
+	Parameterization parameterization = Parameterization::ChordLength;
+
+	// Fails with fewer points than the order or two equal neighbouring points
+	bool interpolate(const std::vector<glm::vec3>& points, int order, Curve& curve);
+	// Moves point index without new parameters or a new factorization.
+	// Control points first .. last change, read them with controlPoint.
+	bool movePoint(int index, glm::vec3 position, int& first, int& last);
+	glm::vec3 controlPoint(int index) const;
+	int pointCount() const;
+
+private:
+	Curve shape; // order and knots of the result
+	std::vector<float> parameters;
+	BandMatrix collocation; // LU factors
+	std::vector<glm::vec3> points;
+	std::vector<glm::dvec3> solution;
+
+	// Column influenceIndex of the inverse, entries influenceFirst .. influenceLast
+	int influenceIndex = -1;
+	int influenceFirst = 0;
+	int influenceLast = -1;
+	std::vector<double> influence;
+};
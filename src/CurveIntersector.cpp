@@ -0,0 +1,338 @@
+#include "CurveIntersector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+#include "Parallel.h"
+
+namespace {
+
+glm::vec2 project(const glm::vec4& point) {
+	return glm::vec2(point) / point.w;
+}
+
+float cross(glm::vec2 a, glm::vec2 b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+// Parameters of one span pair closer than this are the same intersection
+const float sameParameter = 1e-5f;
+
+}
+
+void CurveIntersector::selfIntersect(const Curve& curve, std::vector<CurveIntersection>& intersections) {
+	intersect({ &curve }, true, intersections);
+}
+
+void CurveIntersector::intersect(const std::vector<const Curve*>& curves, bool selfIntersections, std::vector<CurveIntersection>& intersections) {
+	intersections.clear();
+	tasks.clear();
+	curvePairsTested = 0;
+	prepared.resize(curves.size());
+	parallelFor((int)curves.size(), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			prepare(*curves[i], prepared[i]);
+		}
+	});
+
+	// Sweep along x over the curve bounds, only curves that overlap pair up
+	std::vector<int> byLeft;
+	for (int i = 0; i < (int)prepared.size(); i++) {
+		if (prepared[i].bvh.spanCount() > 0) {
+			byLeft.push_back(i);
+		}
+	}
+	std::sort(byLeft.begin(), byLeft.end(), [&](int a, int b) {
+		return prepared[a].bvh.bounds().min.x < prepared[b].bvh.bounds().min.x;
+	});
+	std::vector<std::pair<int, int>> spanPairs;
+	for (size_t i = 0; i < byLeft.size(); i++) {
+		const int a = byLeft[i];
+		const SpanBounds& boundsA = prepared[a].bvh.bounds();
+		for (size_t j = i + 1; j < byLeft.size() && prepared[byLeft[j]].bvh.bounds().min.x <= boundsA.max.x; j++) {
+			const int b = byLeft[j];
+			if (!boundsA.overlaps(prepared[b].bvh.bounds())) {
+				continue;
+			}
+			curvePairsTested++;
+			spanPairs.clear();
+			SpanBvh::overlappingPairs(prepared[std::min(a, b)].bvh, prepared[std::max(a, b)].bvh, spanPairs);
+			for (const std::pair<int, int>& pair : spanPairs) {
+				tasks.push_back({ std::min(a, b), std::max(a, b), pair.first, pair.second });
+			}
+		}
+		if (selfIntersections) {
+			// Pairs of different spans, then every span on its own for loops inside it
+			spanPairs.clear();
+			SpanBvh::overlappingPairs(prepared[a].bvh, prepared[a].bvh, spanPairs);
+			for (const std::pair<int, int>& pair : spanPairs) {
+				tasks.push_back({ a, a, pair.first, pair.second });
+			}
+			const SpanBvh& bvh = prepared[a].bvh;
+			for (int delta = bvh.firstSpan(); delta < bvh.firstSpan() + bvh.spanCount(); delta++) {
+				tasks.push_back({ a, a, delta, delta });
+			}
+		}
+	}
+	spanPairsTested = (int)tasks.size();
+	runTasks(intersections);
+}
+
+void CurveIntersector::prepare(const Curve& curve, Prepared& result) const {
+	result.curve = &curve;
+	result.bvh.build(curve);
+	result.segmentOf.assign(result.bvh.spanCount(), -1);
+	std::vector<float> breakpoints;
+	curve.decomposeBezier(result.bezier, &breakpoints);
+	int segments = 0;
+	for (int i = 0; i < result.bvh.spanCount(); i++) {
+		const int delta = result.bvh.firstSpan() + i;
+		if (curve.knots[delta] < curve.knots[delta + 1]) {
+			result.segmentOf[i] = segments++;
+		}
+	}
+	// Segments follow the non empty spans, anything else means the knots are unusable
+	if (segments + 1 != (int)breakpoints.size() || (int)result.bezier.size() != segments * curve.order) {
+		result.bvh.clear();
+		result.segmentOf.clear();
+	}
+}
+
+void CurveIntersector::runTasks(std::vector<CurveIntersection>& intersections) const {
+	std::mutex merge;
+	parallelFor((int)tasks.size(), 16, [&](int begin, int end) {
+		std::pmr::unsynchronized_pool_resource pool;
+		std::vector<glm::vec2> candidates;
+		std::vector<CurveIntersection> found;
+		for (int t = begin; t < end; t++) {
+			const Task& task = tasks[t];
+			const Prepared& a = prepared[task.curveA];
+			const Prepared& b = prepared[task.curveB];
+			auto piece = [&](const Prepared& curve, int delta) {
+				const int order = curve.curve->order;
+				const int segment = curve.segmentOf[delta - curve.bvh.firstSpan()];
+				Piece result{ std::pmr::vector<glm::vec4>(curve.bezier.begin() + segment * order, curve.bezier.begin() + (segment + 1) * order, &pool),
+					curve.curve->knots[delta], curve.curve->knots[delta + 1], SpanBounds() };
+				bound(result);
+				return result;
+			};
+			const bool self = task.curveA == task.curveB;
+			candidates.clear();
+			const Piece pieceA = piece(a, task.deltaA);
+			if (self && task.deltaA == task.deltaB) {
+				intersectLoops(pieceA, 0, candidates, &pool);
+			}
+			else {
+				intersectPieces(pieceA, piece(b, task.deltaB), 0, candidates, &pool);
+			}
+			const size_t firstFound = found.size();
+			for (glm::vec2 parameters : candidates) {
+				glm::vec3 point;
+				if (!polish(*a.curve, task.deltaA, *b.curve, task.deltaB, parameters, point, &pool)) {
+					continue;
+				}
+				// Neighbouring spans of one curve always meet where they join
+				if (self && std::abs(parameters.x - parameters.y) <= sameParameter) {
+					continue;
+				}
+				if (self && parameters.x > parameters.y) {
+					std::swap(parameters.x, parameters.y);
+				}
+				bool duplicate = false;
+				for (size_t i = firstFound; i < found.size() && !duplicate; i++) {
+					duplicate = std::abs(found[i].uA - parameters.x) <= sameParameter && std::abs(found[i].uB - parameters.y) <= sameParameter;
+				}
+				if (!duplicate) {
+					found.push_back({ task.curveA, task.curveB, parameters.x, parameters.y, point });
+				}
+			}
+		}
+		std::lock_guard<std::mutex> lock(merge);
+		intersections.insert(intersections.end(), found.begin(), found.end());
+	});
+
+	// Crossings on a span boundary are found by the span pairs on both sides of it
+	std::sort(intersections.begin(), intersections.end(), [](const CurveIntersection& a, const CurveIntersection& b) {
+		if (a.curveA != b.curveA) {
+			return a.curveA < b.curveA;
+		}
+		if (a.curveB != b.curveB) {
+			return a.curveB < b.curveB;
+		}
+		return a.uA < b.uA;
+	});
+	size_t kept = 0;
+	for (size_t i = 0; i < intersections.size(); i++) {
+		const CurveIntersection& current = intersections[i];
+		bool duplicate = false;
+		for (size_t j = kept; j-- > 0;) {
+			const CurveIntersection& previous = intersections[j];
+			if (previous.curveA != current.curveA || previous.curveB != current.curveB || current.uA - previous.uA > sameParameter) {
+				break;
+			}
+			if (std::abs(previous.uB - current.uB) <= sameParameter) {
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate) {
+			intersections[kept++] = current;
+		}
+	}
+	intersections.resize(kept);
+}
+
+// Splits the larger piece that is not yet flat until both are flat, then
+// crosses their chords
+void CurveIntersector::intersectPieces(const Piece& a, const Piece& b, int depth, std::vector<glm::vec2>& candidates, std::pmr::memory_resource* scratch) const {
+	if (!a.bounds.overlaps(b.bounds)) {
+		return;
+	}
+	const bool flatA = flat(a);
+	const bool flatB = flat(b);
+	if (depth >= maxDepth) {
+		candidates.emplace_back(0.5f * (a.low + a.high), 0.5f * (b.low + b.high));
+		return;
+	}
+	if (flatA && flatB) {
+		const glm::vec2 startA = project(a.points.front());
+		const glm::vec2 chordA = project(a.points.back()) - startA;
+		const glm::vec2 startB = project(b.points.front());
+		const glm::vec2 chordB = project(b.points.back()) - startB;
+		const float denominator = cross(chordA, chordB);
+		// Parallel chords either miss or overlap, and overlapping curves have no single crossing
+		if (std::abs(denominator) <= 1e-12f * glm::length(chordA) * glm::length(chordB) || denominator == 0.0f) {
+			return;
+		}
+		const float s = cross(startB - startA, chordB) / denominator;
+		const float t = cross(startB - startA, chordA) / denominator;
+		const float slack = 1e-3f;
+		if (s >= -slack && s <= 1 + slack && t >= -slack && t <= 1 + slack) {
+			candidates.emplace_back(a.low + glm::clamp(s, 0.0f, 1.0f) * (a.high - a.low), b.low + glm::clamp(t, 0.0f, 1.0f) * (b.high - b.low));
+		}
+		return;
+	}
+	const glm::vec2 sizeA = a.bounds.max - a.bounds.min;
+	const glm::vec2 sizeB = b.bounds.max - b.bounds.min;
+	Piece left{ std::pmr::vector<glm::vec4>(scratch), 0, 0, SpanBounds() };
+	Piece right{ std::pmr::vector<glm::vec4>(scratch), 0, 0, SpanBounds() };
+	if (!flatA && (flatB || sizeA.x + sizeA.y >= sizeB.x + sizeB.y)) {
+		split(a, left, right);
+		intersectPieces(left, b, depth + 1, candidates, scratch);
+		intersectPieces(right, b, depth + 1, candidates, scratch);
+	}
+	else {
+		split(b, left, right);
+		intersectPieces(a, left, depth + 1, candidates, scratch);
+		intersectPieces(a, right, depth + 1, candidates, scratch);
+	}
+}
+
+// A piece whose control polygon turns by less than half a turn moves
+// forward along one direction the whole way and can't cross itself.
+// Otherwise the halves are checked on their own and against each other.
+void CurveIntersector::intersectLoops(const Piece& piece, int depth, std::vector<glm::vec2>& candidates, std::pmr::memory_resource* scratch) const {
+	if (depth >= maxDepth || piece.points.size() < 3) {
+		return;
+	}
+	float turning = 0;
+	glm::vec2 previous(0);
+	for (size_t i = 1; i < piece.points.size(); i++) {
+		const glm::vec2 edge = project(piece.points[i]) - project(piece.points[i - 1]);
+		if (edge == glm::vec2(0)) {
+			continue;
+		}
+		if (previous != glm::vec2(0)) {
+			turning += std::abs(std::atan2(cross(previous, edge), glm::dot(previous, edge)));
+		}
+		previous = edge;
+	}
+	if (turning < 3.14159265f) {
+		return;
+	}
+	Piece left{ std::pmr::vector<glm::vec4>(scratch), 0, 0, SpanBounds() };
+	Piece right{ std::pmr::vector<glm::vec4>(scratch), 0, 0, SpanBounds() };
+	split(piece, left, right);
+	intersectLoops(left, depth + 1, candidates, scratch);
+	intersectLoops(right, depth + 1, candidates, scratch);
+	intersectPieces(left, right, depth + 1, candidates, scratch);
+}
+
+// The piece lies in the hull of its control points, their distance from the chord bounds its own
+bool CurveIntersector::flat(const Piece& piece) const {
+	const glm::vec2 start = project(piece.points.front());
+	const glm::vec2 chord = project(piece.points.back()) - start;
+	const float length = glm::length(chord);
+	for (size_t i = 1; i + 1 < piece.points.size(); i++) {
+		const glm::vec2 offset = project(piece.points[i]) - start;
+		const float distance = length > 0 ? std::abs(cross(chord, offset)) / length : glm::length(offset);
+		if (distance > tolerance) {
+			return false;
+		}
+	}
+	// A chord shorter than the tolerance is flat whatever its hull looks like
+	return true;
+}
+
+// de Casteljau at the middle of the piece
+void CurveIntersector::split(const Piece& piece, Piece& left, Piece& right) {
+	const int order = (int)piece.points.size();
+	left.points.resize(order);
+	right.points.resize(order);
+	std::pmr::vector<glm::vec4> level(piece.points, piece.points.get_allocator());
+	left.points[0] = level[0];
+	right.points[order - 1] = level[order - 1];
+	for (int r = 1; r < order; r++) {
+		for (int i = 0; i < order - r; i++) {
+			level[i] = 0.5f * (level[i] + level[i + 1]);
+		}
+		left.points[r] = level[0];
+		right.points[order - 1 - r] = level[order - 1 - r];
+	}
+	const float middle = 0.5f * (piece.low + piece.high);
+	left.low = piece.low;
+	left.high = middle;
+	right.low = middle;
+	right.high = piece.high;
+	bound(left);
+	bound(right);
+}
+
+void CurveIntersector::bound(Piece& piece) {
+	piece.bounds = SpanBounds();
+	for (const glm::vec4& point : piece.points) {
+		piece.bounds.expand(project(point));
+	}
+}
+
+// Newton on A(uA) - B(uB) = 0, each parameter kept inside its span. Tangent
+// curves leave the Jacobian singular, the estimate then stands as it is.
+bool CurveIntersector::polish(const Curve& a, int deltaA, const Curve& b, int deltaB, glm::vec2& parameters, glm::vec3& point, std::pmr::memory_resource* scratch) const {
+	const glm::vec2 low(a.knots[deltaA], b.knots[deltaB]);
+	const glm::vec2 high(a.knots[deltaA + 1], b.knots[deltaB + 1]);
+	glm::vec3 derivativesA[2];
+	glm::vec3 derivativesB[2];
+	for (int iteration = 0; iteration < 8; iteration++) {
+		a.derivativesAt(deltaA, parameters.x, 1, derivativesA, scratch);
+		b.derivativesAt(deltaB, parameters.y, 1, derivativesB, scratch);
+		const glm::vec2 difference = glm::vec2(derivativesA[0] - derivativesB[0]);
+		const glm::mat2 jacobian(glm::vec2(derivativesA[1]), -glm::vec2(derivativesB[1]));
+		const float determinant = glm::determinant(jacobian);
+		if (std::abs(determinant) <= 1e-12f * glm::length(glm::vec2(derivativesA[1])) * glm::length(glm::vec2(derivativesB[1])) || determinant == 0.0f) {
+			break;
+		}
+		const glm::vec2 next = glm::clamp(parameters - glm::inverse(jacobian) * difference, low, high);
+		const bool converged = glm::all(glm::lessThanEqual(glm::abs(next - parameters), glm::vec2(1e-7f)));
+		parameters = next;
+		if (converged) {
+			break;
+		}
+	}
+	const glm::vec3 pointA = a.evaluate(deltaA, parameters.x, scratch);
+	const glm::vec3 pointB = b.evaluate(deltaB, parameters.y, scratch);
+	point = 0.5f * (pointA + pointB);
+	// Chords within tolerance of their pieces cross within twice that of the curves
+	return glm::distance(glm::vec2(pointA), glm::vec2(pointB)) <= 2.0f * tolerance;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory_resource>
+#include <vector>
+
+#include "Curve.h"
+#include "SpanBvh.h"
+
+// Point where curve curveA at uA meets curve curveB at uB. A self
+// intersection has curveA == curveB and uA < uB.
+struct CurveIntersection {
+	int curveA = 0;
+	int curveB = 0;
+	float uA = 0;
+	float uB = 0;
+	glm::vec3 point = glm::vec3(0);
+};
+
+// Intersections between any number of curves, and of curves with themselves.
+// Curves whose bounds overlap are found with a sweep along x, their span BVHs
+// pair up the spans that can touch, and every pair of spans is split as
+// rational Bezier pieces until both are flat. Crossing chords give the
+// starting point of a Newton polish on A(uA) - B(uB) = 0. The span pairs
+// are independent and run on the worker threads.
+class CurveIntersector {
+
+public:
+	float tolerance = 1e-4f; // curve space flatness of the pieces before the polish
+	int maxDepth = 32;
+
+	// Curves with fewer points than their order are skipped
+	void intersect(const std::vector<const Curve*>& curves, bool selfIntersections, std::vector<CurveIntersection>& intersections);
+	void selfIntersect(const Curve& curve, std::vector<CurveIntersection>& intersections);
+
+	// Work done by the last call, to compare against testing every pair
+	int curvePairsTested = 0;
+	int spanPairsTested = 0;
+
+private:
+	// One curve split into Bezier segments, segmentOf maps a span to its
+	// segment in bezier or -1 for spans of zero length
+	struct Prepared {
+		const Curve* curve = nullptr;
+		SpanBvh bvh;
+		std::vector<glm::vec4> bezier;
+		std::vector<int> segmentOf;
+	};
+	// Spans deltaA and deltaB of two curves, deltaA == deltaB for the loops of one span
+	struct Task {
+		int curveA;
+		int curveB;
+		int deltaA;
+		int deltaB;
+	};
+	// Part of a span as homogeneous Bezier points over [low, high]
+	struct Piece {
+		std::pmr::vector<glm::vec4> points;
+		float low;
+		float high;
+		SpanBounds bounds;
+	};
+
+	std::vector<Prepared> prepared;
+	std::vector<Task> tasks;
+
+	void prepare(const Curve& curve, Prepared& result) const;
+	void runTasks(std::vector<CurveIntersection>& intersections) const;
+	void intersectPieces(const Piece& a, const Piece& b, int depth, std::vector<glm::vec2>& candidates, std::pmr::memory_resource* scratch) const;
+	void intersectLoops(const Piece& piece, int depth, std::vector<glm::vec2>& candidates, std::pmr::memory_resource* scratch) const;
+	bool flat(const Piece& piece) const;
+	bool polish(const Curve& a, int deltaA, const Curve& b, int deltaB, glm::vec2& parameters, glm::vec3& point, std::pmr::memory_resource* scratch) const;
+	static void split(const Piece& piece, Piece& left, Piece& right);
+	static void bound(Piece& piece);
+};
@@ -0,0 +1,207 @@
+#include "CurveProjector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <numeric>
+
+#include "Parallel.h"
+
+namespace {
+
+// Stack memory for the scratch of one query, only very high orders reach the heap
+struct QueryScratch {
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource resource{ buffer, sizeof(buffer) };
+};
+
+// Interleaves the bits of two 16 bit values, nearby points get nearby codes
+uint32_t mortonCode(uint32_t x, uint32_t y) {
+	auto spread = [](uint32_t v) {
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+}
+
+Projection CurveProjector::project(const Curve& curve, const SpanBvh& bvh, glm::vec2 point, float maxDistance) const {
+	return projectWith(curve, bvh, nullptr, point, maxDistance);
+}
+
+void CurveProjector::buildSamples(const Curve& curve, const SpanBvh& bvh, SampleTable& table) const {
+	const int stride = samplesPerSpan + 1;
+	table.firstSpan = bvh.firstSpan();
+	table.x.assign(bvh.spanCount() * stride, 0.0f);
+	table.y.assign(bvh.spanCount() * stride, 0.0f);
+	parallelFor(bvh.spanCount(), 64, [&](int begin, int end) {
+		QueryScratch scratch;
+		for (int span = begin; span < end; span++) {
+			const int delta = table.firstSpan + span;
+			const float low = curve.knots[delta];
+			const float high = curve.knots[delta + 1];
+			if (!(low < high)) {
+				continue;
+			}
+			for (int i = 0; i < stride; i++) {
+				const glm::vec3 sample = curve.evaluate(delta, low + (high - low) * i / samplesPerSpan, &scratch.resource);
+				table.x[span * stride + i] = sample.x;
+				table.y[span * stride + i] = sample.y;
+			}
+			scratch.resource.release();
+		}
+	});
+}
+
+Projection CurveProjector::projectWith(const Curve& curve, const SpanBvh& bvh, const SampleTable* table, glm::vec2 point, float maxDistance) const {
+	Projection best;
+	if (bvh.spanCount() == 0) {
+		return best;
+	}
+	// The pool hands freed blocks back out, so visiting many spans stays on the stack
+	QueryScratch scratch;
+	std::pmr::unsynchronized_pool_resource pool(&scratch.resource);
+	const int stride = samplesPerSpan + 1;
+	std::pmr::vector<float> x(&pool);
+	std::pmr::vector<float> y(&pool);
+	std::pmr::vector<float> scratchDistances(stride, &pool);
+	if (table == nullptr) {
+		x.resize(stride);
+		y.resize(stride);
+	}
+	bvh.nearest(point, maxDistance, [&](int delta, float bestDistance) {
+		const float low = curve.knots[delta];
+		const float high = curve.knots[delta + 1];
+		const float* xs;
+		const float* ys;
+		if (table != nullptr) {
+			xs = &table->x[(delta - table->firstSpan) * stride];
+			ys = &table->y[(delta - table->firstSpan) * stride];
+		}
+		else {
+			for (int i = 0; i < stride; i++) {
+				const glm::vec3 sample = curve.evaluate(delta, low + (high - low) * i / samplesPerSpan, &pool);
+				x[i] = sample.x;
+				y[i] = sample.y;
+			}
+			xs = x.data();
+			ys = y.data();
+		}
+		// Squared distances and the widest gap between samples, plain loops over
+		// the arrays the compiler can vectorize
+		float* distances = scratchDistances.data();
+		float gap = 0.0f;
+		for (int i = 0; i < stride; i++) {
+			const float dx = xs[i] - point.x;
+			const float dy = ys[i] - point.y;
+			distances[i] = dx * dx + dy * dy;
+		}
+		for (int i = 1; i < stride; i++) {
+			const float dx = xs[i] - xs[i - 1];
+			const float dy = ys[i] - ys[i - 1];
+			gap = std::max(gap, dx * dx + dy * dy);
+		}
+		// Between two samples the curve stays within about half the gap of one of
+		// them, so a local minimum further than that from the best can't beat it
+		const float margin = std::sqrt(gap);
+		for (int i = 0; i < stride; i++) {
+			if ((i > 0 && distances[i - 1] < distances[i]) || (i < samplesPerSpan && distances[i + 1] < distances[i])) {
+				continue;
+			}
+			if (std::sqrt(distances[i]) - margin >= bestDistance) {
+				continue;
+			}
+			const Projection candidate = refine(curve, delta, point, i, &pool);
+			if (candidate.distance < bestDistance) {
+				best = candidate;
+				bestDistance = candidate.distance;
+			}
+		}
+		return bestDistance;
+	});
+	return best;
+}
+
+// Safeguarded Newton on f(u) = C'(u).(C(u) - p). Each step shrinks the bracket
+// around the sample from the sign of f, and steps that leave it bisect instead.
+Projection CurveProjector::refine(const Curve& curve, int delta, glm::vec2 point, int sample, std::pmr::memory_resource* scratch) const {
+	const float low = curve.knots[delta];
+	const float high = curve.knots[delta + 1];
+	const float step = (high - low) / samplesPerSpan;
+	float lower = std::max(low, low + (sample - 1) * step);
+	float upper = std::min(high, low + (sample + 1) * step);
+	float u = low + sample * step;
+
+	glm::vec3 derivatives[3];
+	for (int iteration = 0; iteration < newtonIterations; iteration++) {
+		curve.derivativesAt(delta, u, 2, derivatives, scratch);
+		const glm::vec2 offset = glm::vec2(derivatives[0]) - point;
+		const glm::vec2 first = glm::vec2(derivatives[1]);
+		const float f = glm::dot(first, offset);
+		const float slope = glm::dot(glm::vec2(derivatives[2]), offset) + glm::dot(first, first);
+		if (f > 0.0f) {
+			upper = u;
+		}
+		else {
+			lower = u;
+		}
+		float next = slope > 0.0f ? u - f / slope : 0.5f * (lower + upper);
+		if (!(next > lower && next < upper)) {
+			next = 0.5f * (lower + upper);
+		}
+		if (std::abs(next - u) <= 1e-7f * std::max(1.0f, std::abs(u))) {
+			u = next;
+			break;
+		}
+		u = next;
+	}
+
+	Projection result;
+	result.u = u;
+	result.point = curve.evaluate(delta, u, scratch);
+	result.distance = glm::distance(glm::vec2(result.point), point);
+	// The minimum can sit on an end of the bracket, where f doesn't vanish
+	for (float end : { lower, upper }) {
+		const glm::vec3 endPoint = curve.evaluate(delta, end, scratch);
+		const float endDistance = glm::distance(glm::vec2(endPoint), point);
+		if (endDistance < result.distance) {
+			result = { end, endPoint, endDistance };
+		}
+	}
+	return result;
+}
+
+void CurveProjector::projectBatch(const Curve& curve, const SpanBvh& bvh, const glm::vec2* points, int count, Projection* results) const {
+	if (count <= 0) {
+		return;
+	}
+	SampleTable table;
+	buildSamples(curve, bvh, table);
+
+	// Queries in Morton order, so neighbouring queries visit the same spans
+	// and find their samples already in cache
+	glm::vec2 low = points[0];
+	glm::vec2 high = points[0];
+	for (int i = 1; i < count; i++) {
+		low = glm::min(low, points[i]);
+		high = glm::max(high, points[i]);
+	}
+	const glm::vec2 scale = 65535.0f / glm::max(high - low, glm::vec2(1e-20f));
+	std::vector<uint64_t> order(count);
+	for (int i = 0; i < count; i++) {
+		const glm::uvec2 cell = glm::uvec2((points[i] - low) * scale);
+		order[i] = ((uint64_t)mortonCode(cell.x, cell.y) << 32) | (uint32_t)i;
+	}
+	std::sort(order.begin(), order.end());
+
+	parallelFor(count, 1024, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const int query = (int)(order[i] & 0xFFFFFFFF);
+			results[query] = projectWith(curve, bvh, &table, points[query], 1e30f);
+		}
+	});
+}
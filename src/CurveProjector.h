@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Curve.h"
+#include "SpanBvh.h"
+
+// Closest point on a curve to a query point
+struct Projection {
+	float u = 0;
+	glm::vec3 point = glm::vec3(0);
+	float distance = 1e30f; // 1e30 when nothing was found within range
+};
+
+// Point to curve projection in three stages. The span BVH discards every
+// span whose bounds are further away than the best answer so far, samples
+// of the remaining spans give a starting parameter, and Newton's method on
+// C'(u).(C(u) - p) = 0, kept inside the bracket around that sample, refines it.
+class CurveProjector {
+
+public:
+	int samplesPerSpan = 16;
+	int newtonIterations = 8;
+
+	Projection project(const Curve& curve, const SpanBvh& bvh, glm::vec2 point, float maxDistance = 1e30f) const;
+	// Projects many points at once on the worker threads
+	void projectBatch(const Curve& curve, const SpanBvh& bvh, const glm::vec2* points, int count, Projection* results) const;
+
+private:
+	// Samples of every span, one structure of arrays for the whole curve
+	struct SampleTable {
+		int firstSpan = 0;
+		std::vector<float> x;
+		std::vector<float> y;
+	};
+
+	void buildSamples(const Curve& curve, const SpanBvh& bvh, SampleTable& table) const;
+	Projection projectWith(const Curve& curve, const SpanBvh& bvh, const SampleTable* table, glm::vec2 point, float maxDistance) const;
+	Projection refine(const Curve& curve, int delta, glm::vec2 point, int sample, std::pmr::memory_resource* scratch) const;
+};
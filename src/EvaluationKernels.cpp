@@ -0,0 +1,16 @@
+#include "EvaluationKernels.h"
+
+EvaluateKernel evaluateKernel(int order) {
+	static const EvaluateKernel kernels[maxKernelOrder + 1] = {
+		nullptr,
+		nullptr,
+		evaluateFixedOrder<2>,
+		evaluateFixedOrder<3>,
+		evaluateFixedOrder<4>,
+		evaluateFixedOrder<5>,
+		evaluateFixedOrder<6>,
+		evaluateFixedOrder<7>,
+		evaluateFixedOrder<8>
+	};
+	return order >= 0 && order <= maxKernelOrder ? kernels[order] : nullptr;
+}
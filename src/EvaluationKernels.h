@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Curve.h"
+
+// de Boor's algorithm with the order known at compile time. The triangle
+// is a fixed size array of homogeneous points that the compiler unrolls and
+// keeps in registers, with no scratch memory and a single pass for the
+// position and the weight. delta is the knot span as for Curve::evaluate.
+template <int Order>
+glm::vec3 evaluateFixedOrder(const Curve& curve, int delta, float uValue) {
+	const int first = delta - Order + 1;
+	glm::vec4 points[Order];
+	for (int i = 0; i < Order; i++) {
+		const float weight = curve.weights[first + i];
+		points[i] = glm::vec4(curve.controlPoints[first + i] * weight, weight);
+	}
+	for (int level = 1; level < Order; level++) {
+		for (int i = Order - 1; i >= level; i--) {
+			const float low = curve.knots[first + i];
+			const float alpha = (uValue - low) / (curve.knots[first + i + Order - level] - low);
+			points[i] = alpha * points[i] + (1.0f - alpha) * points[i - 1];
+		}
+	}
+	return glm::vec3(points[Order - 1]) / points[Order - 1].w;
+}
+
+using EvaluateKernel = glm::vec3 (*)(const Curve& curve, int delta, float uValue);
+
+const int maxKernelOrder = 8;
+
+// The kernel for an order from 2 to maxKernelOrder, nullptr for the others
+EvaluateKernel evaluateKernel(int order);
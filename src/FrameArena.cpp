@@ -0,0 +1,121 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+FrameArena::FrameArena(size_t initialSize) {
+	offset = 0;
+	used = 0;
+	blockAllocations = 0;
+	lastFrameBytes = 0;
+	lastFrameBlockAllocations = 0;
+	blocks.reserve(8);
+	addBlock(initialSize);
+}
+
+FrameArena::~FrameArena() {
+	for (Block& block : blocks) {
+		std::free(block.data);
+	}
+}
+
+void FrameArena::addBlock(size_t size) {
+	char* data = static_cast<char*>(std::malloc(size));
+	if (data == nullptr) {
+		throw std::bad_alloc();
+	}
+	blocks.push_back({ data, size });
+	offset = 0;
+	blockAllocations++;
+}
+
+// Offset at or after from where the block's memory meets the alignment
+static size_t alignedOffset(const char* data, size_t from, size_t alignment) {
+	const uintptr_t address = reinterpret_cast<uintptr_t>(data + from);
+	return from + (alignment - address % alignment) % alignment;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+	size_t start = alignedOffset(blocks.back().data, offset, alignment);
+	if (start + bytes > blocks.back().size) {
+		// Grow geometrically so an overflowing frame needs few extra blocks
+		addBlock(std::max(blocks.back().size * 2, bytes + alignment));
+		start = alignedOffset(blocks.back().data, 0, alignment);
+	}
+	offset = start + bytes;
+	used += bytes;
+	return blocks.back().data + start;
+}
+
+// Individual frees are ignored, everything is released by reset()
+void FrameArena::do_deallocate(void*, size_t, size_t) {
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+// Called once at the end of every frame
+void FrameArena::reset() {
+	lastFrameBytes = used;
+	lastFrameBlockAllocations = blockAllocations;
+	if (blocks.size() > 1) {
+		// Replace the overflow chain by one block big enough for the whole frame
+		size_t total = 0;
+		for (Block& block : blocks) {
+			total += block.size;
+			std::free(block.data);
+		}
+		blocks.clear();
+		addBlock(total);
+	}
+	offset = 0;
+	used = 0;
+	blockAllocations = 0;
+}
+
+size_t FrameArena::capacity() const {
+	size_t total = 0;
+	for (const Block& block : blocks) {
+		total += block.size;
+	}
+	return total;
+}
+
+static std::atomic<size_t> globalAllocations{ 0 };
+
+size_t AllocationCounter::count() {
+	return globalAllocations.load(std::memory_order_relaxed);
+}
+
+// Replacements of the global allocation functions that only add counting
+void* operator new(size_t size) {
+	globalAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for scratch memory that only lives for one frame. Memory is
+// never freed individually, reset() at the end of the frame rewinds it. When a
+// frame overflows the arena the blocks are merged on reset, so a steady state
+// frame is served from a single block without touching the heap.
+class FrameArena : public std::pmr::memory_resource {
+
+public:
+	explicit FrameArena(size_t initialSize = 64 * 1024);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void reset();
+
+	// Statistics of the last completed frame
+	size_t lastFrameBytes;
+	int lastFrameBlockAllocations;
+	size_t capacity() const;
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	struct Block {
+		char* data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t offset;  // position in the newest block
+	size_t used;    // bytes handed out this frame
+	int blockAllocations;
+
+	void addBlock(size_t size);
+};
+
+// Counts calls to the global operator new so heap churn per frame can be reported
+class AllocationCounter {
+
+public:
+	static size_t count();
+};
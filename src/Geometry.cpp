@@ -1,9 +1,43 @@
 #include "Geometry.h"
 
+#include <algorithm>
+#include <cstdint>
+
 Geometry::Geometry() {
 	drawMode = GL_LINE_STRIP;
 	vao = 0;
 	vertexBuffer = 0;
-	modelMatrix = glm::mat4(1.f);
+	bufferCapacity = 0;
 	color = glm::vec4(1.0f);
+	visible = true;
+	material = 0;
+	transform = 0;
+	layer = 0;
+	view = nullptr;
+	viewFirst = 0;
+	viewCount = 0;
+}
+
+void Geometry::setView(const std::vector<glm::vec3>* source, size_t first, size_t count) {
+	view = source;
+	viewFirst = first;
+	viewCount = count;
+}
+
+void Geometry::setView(const std::vector<glm::vec3>* source) {
+	setView(source, 0, SIZE_MAX);
+}
+
+const glm::vec3* Geometry::vertexData() const {
+	if (view == nullptr) {
+		return verts.data();
+	}
+	return view->data() + std::min(viewFirst, view->size());
+}
+
+size_t Geometry::vertexCount() const {
+	if (view == nullptr) {
+		return verts.size();
+	}
+	return viewFirst >= view->size() ? 0 : std::min(viewCount, view->size() - viewFirst);
 }
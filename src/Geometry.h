@@ -5,6 +5,8 @@
 
 #include <vector>
 
+#include "RenderRegistry.h"
+
 class Geometry {
 
 public:
@@ -15,7 +17,24 @@ public:
 
 	GLuint vao;
 	GLuint vertexBuffer;
+	size_t bufferCapacity; // vertices the GPU buffer can hold without reallocating
 	std::vector<glm::vec3> verts;
-	glm::mat4 modelMatrix;
-};
+	bool visible;
+
+	// Draw state held by the RenderEngine's registry
+	RenderHandle handle;
+	uint32_t material;
+	uint32_t transform; // transform registered with the RenderEngine, 0 is identity
+	int layer;
 
+	// Draw a range of model storage instead of verts, without copying it
+	void setView(const std::vector<glm::vec3>* source, size_t first, size_t count);
+	void setView(const std::vector<glm::vec3>* source);
+	const glm::vec3* vertexData() const;
+	size_t vertexCount() const;
+
+private:
+	const std::vector<glm::vec3>* view;
+	size_t viewFirst;
+	size_t viewCount; // SIZE_MAX views everything from viewFirst on
+};
@@ -0,0 +1,307 @@
+#include "HierarchicalCurve.h"
+
+#include <algorithm>
+
+void HierarchicalCurve::reset(const Curve& curve) {
+	base.order = curve.order;
+	base.knots = curve.knots;
+	base.controlPoints.clear();
+	base.weights.clear();
+	levels.clear();
+	spanStarts.clear();
+	spansBefore.assign(curve.knots.size(), 0);
+	combined = curve;
+	combinedStale = false;
+	const int n = (int)curve.controlPoints.size();
+	if (n < curve.order || curve.knots.size() != n + curve.order) {
+		return;
+	}
+	for (int k = 0; k < (int)curve.knots.size(); k++) {
+		spansBefore[k] = (int)spanStarts.size();
+		if (k >= curve.order - 1 && k < n && curve.knots[k] < curve.knots[k + 1]) {
+			spanStarts.push_back(k);
+		}
+	}
+	levels.emplace_back();
+	levels[0].cells.push_back({ 0, (int)spanStarts.size() });
+	updateActive(0, curve);
+}
+
+int HierarchicalCurve::levelAt(float u) const {
+	for (int l = (int)levels.size() - 1; l > 0; l--) {
+		const int cell = cellAt(l, u);
+		if (inside(levels[l].cells, cell, cell + 1)) {
+			return l;
+		}
+	}
+	return 0;
+}
+
+bool HierarchicalCurve::refine(int level, float low, float high) {
+	if (level < 0 || level >= (int)levels.size() || low > high) {
+		return false;
+	}
+	return refineCells(level, cellAt(level, low), cellAt(level, high) + 1);
+}
+
+bool HierarchicalCurve::refineAround(float u, int cells) {
+	if (levels.empty()) {
+		return false;
+	}
+	const int level = levelAt(u);
+	const int cell = cellAt(level, u);
+	return refineCells(level, cell - cells, cell + cells + 1);
+}
+
+const Curve& HierarchicalCurve::curve() const {
+	if (combinedStale) {
+		combine(combined, (int)levels.size() - 1);
+		combinedStale = false;
+	}
+	return combined;
+}
+
+bool HierarchicalCurve::represents(const Curve& other) const {
+	const Curve& own = curve();
+	return !levels.empty() && own.order == other.order && own.knots == other.knots
+		&& own.controlPoints == other.controlPoints && own.weights == other.weights;
+}
+
+// u is clamped into the domain
+glm::vec3 HierarchicalCurve::evaluate(float u, std::pmr::memory_resource* scratch) const {
+	if (levels.empty()) {
+		return glm::vec3(0);
+	}
+	const Curve& own = curve();
+	u = std::clamp(u, own.knots[own.order - 1], own.knots[own.controlPoints.size()]);
+	return own.evaluate(own.findSpan(u), u, scratch);
+}
+
+// Every active function keeps its level index, point and weight; a level
+// also keeps its cell ranges. The single B-splines keep a point, a weight
+// and a knot for every function.
+HierarchyMemory HierarchicalCurve::memory() const {
+	HierarchyMemory report;
+	if (levels.empty()) {
+		return report;
+	}
+	const size_t pointBytes = sizeof(glm::vec3) + sizeof(float);
+	report.levels = (int)levels.size();
+	report.hierarchyBytes = base.knots.size() * sizeof(float);
+	for (const Level& level : levels) {
+		report.activeFunctions += (int)level.functions.size();
+		report.hierarchyBytes += level.functions.size() * (pointBytes + sizeof(int));
+		report.hierarchyBytes += level.cells.size() * sizeof(std::pair<int, int>);
+	}
+	const Curve& own = curve();
+	report.localPoints = (int)own.controlPoints.size();
+	report.localBytes = own.controlPoints.size() * pointBytes + own.knots.size() * sizeof(float);
+	const int added = (int)spanStarts.size() * ((1 << (report.levels - 1)) - 1);
+	report.globalPoints = (int)base.knots.size() - base.order + added;
+	report.globalBytes = report.globalPoints * pointBytes + (base.knots.size() + added) * sizeof(float);
+	return report;
+}
+
+// A non-empty domain span of the base holds 2^level knots of the level, a
+// knot outside the domain or repeated stays a single knot
+int HierarchicalCurve::levelKnotCount(int level) const {
+	return levelIndex(level, (int)base.knots.size() - 1) + 1;
+}
+
+int HierarchicalCurve::levelIndex(int level, int baseKnot) const {
+	return baseKnot + spansBefore[baseKnot] * ((1 << level) - 1);
+}
+
+int HierarchicalCurve::baseKnotOf(int level, int index) const {
+	int low = 0;
+	int high = (int)base.knots.size() - 1;
+	while (low < high) {
+		const int middle = (low + high + 1) / 2;
+		if (levelIndex(level, middle) <= index) {
+			low = middle;
+		}
+		else {
+			high = middle - 1;
+		}
+	}
+	return low;
+}
+
+// Dividing by a power of two is exact, so a knot shared by two levels gets
+// the same value from both
+float HierarchicalCurve::levelKnot(int level, int index) const {
+	const int k = baseKnotOf(level, index);
+	const int offset = index - levelIndex(level, k);
+	if (offset == 0) {
+		return base.knots[k];
+	}
+	return base.knots[k] + (base.knots[k + 1] - base.knots[k]) * ((float)offset / (float)(1 << level));
+}
+
+// Cells of the level before knot index
+int HierarchicalCurve::cellOf(int level, int index) const {
+	const int k = baseKnotOf(level, index);
+	return spansBefore[k] * (1 << level) + index - levelIndex(level, k);
+}
+
+// Knot index at the start of a cell
+int HierarchicalCurve::cellStart(int level, int cell) const {
+	return levelIndex(level, spanStarts[cell >> level]) + (cell & ((1 << level) - 1));
+}
+
+int HierarchicalCurve::cellAt(int level, float u) const {
+	auto span = std::upper_bound(spanStarts.begin(), spanStarts.end(), u, [&](float value, int start) {
+		return value < base.knots[start];
+	});
+	const int s = std::max((int)(span - spanStarts.begin()) - 1, 0);
+	const float low = base.knots[spanStarts[s]];
+	const float high = base.knots[spanStarts[s] + 1];
+	const int offset = std::clamp((int)((u - low) / (high - low) * (1 << level)), 0, (1 << level) - 1);
+	return s * (1 << level) + offset;
+}
+
+bool HierarchicalCurve::inside(const std::vector<std::pair<int, int>>& cells, int first, int last) {
+	auto range = std::upper_bound(cells.begin(), cells.end(), first, [](int cell, const std::pair<int, int>& range) {
+		return cell < range.first;
+	});
+	return range != cells.begin() && last <= std::prev(range)->second;
+}
+
+bool HierarchicalCurve::active(int level, int function) const {
+	const int first = cellOf(level, function);
+	const int last = cellOf(level, function + base.order);
+	if (first >= last || !inside(levels[level].cells, first, last)) {
+		return false;
+	}
+	return level + 1 >= (int)levels.size() || !inside(levels[level + 1].cells, 2 * first, 2 * last);
+}
+
+// The knots of a function inside the level's cells are all in the curve,
+// with the multiplicity they have in the level
+int HierarchicalCurve::combinedIndex(const Curve& curve, int level, int function) const {
+	const float value = levelKnot(level, function);
+	int first = function;
+	while (first > 0 && levelKnot(level, first - 1) == value) {
+		first--;
+	}
+	const int position = (int)(std::lower_bound(curve.knots.begin(), curve.knots.end(), value) - curve.knots.begin());
+	return position + function - first;
+}
+
+// Functions that stay active keep their coefficients, new ones take theirs
+// from source, which must hold the level's knots in the level's cells
+void HierarchicalCurve::updateActive(int level, const Curve& source) {
+	Level& current = levels[level];
+	std::vector<int> functions;
+	std::vector<glm::vec3> points;
+	std::vector<float> weights;
+	const int count = levelKnotCount(level);
+	for (const std::pair<int, int>& range : current.cells) {
+		int j = cellStart(level, range.first);
+		while (j > 0 && cellOf(level, j - 1) >= range.first) {
+			j--;
+		}
+		for (; j + base.order < count && cellOf(level, j + base.order) <= range.second; j++) {
+			if (!active(level, j)) {
+				continue;
+			}
+			auto kept = std::lower_bound(current.functions.begin(), current.functions.end(), j);
+			functions.push_back(j);
+			if (kept != current.functions.end() && *kept == j) {
+				points.push_back(current.points[kept - current.functions.begin()]);
+				weights.push_back(current.weights[kept - current.functions.begin()]);
+			}
+			else {
+				const int index = combinedIndex(source, level, j);
+				points.push_back(source.controlPoints[index]);
+				weights.push_back(source.weights[index]);
+			}
+		}
+	}
+	current.functions.swap(functions);
+	current.points.swap(points);
+	current.weights.swap(weights);
+}
+
+// The new functions of the finer level take the coefficients the combined
+// curve has there before any finer level is applied, which leaves every
+// truncated function as it was
+bool HierarchicalCurve::refineCells(int level, int first, int last) {
+	if (level < 0 || level >= (int)levels.size()) {
+		return false;
+	}
+	const bool finerExists = level + 1 < (int)levels.size();
+	std::vector<std::pair<int, int>> added;
+	for (const std::pair<int, int>& range : levels[level].cells) {
+		for (int c = std::max(range.first, first); c < std::min(range.second, last); c++) {
+			if (finerExists && inside(levels[level + 1].cells, 2 * c, 2 * c + 2)) {
+				continue;
+			}
+			if (!added.empty() && added.back().second == c) {
+				added.back().second++;
+			}
+			else {
+				added.push_back({ c, c + 1 });
+			}
+		}
+	}
+	if (added.empty()) {
+		return false;
+	}
+
+	if (!finerExists) {
+		levels.emplace_back();
+	}
+	std::vector<std::pair<int, int>>& cells = levels[level + 1].cells;
+	for (const std::pair<int, int>& range : added) {
+		cells.push_back({ 2 * range.first, 2 * range.second });
+	}
+	std::sort(cells.begin(), cells.end());
+	std::vector<std::pair<int, int>> merged;
+	for (const std::pair<int, int>& range : cells) {
+		if (!merged.empty() && range.first <= merged.back().second) {
+			merged.back().second = std::max(merged.back().second, range.second);
+		}
+		else {
+			merged.push_back(range);
+		}
+	}
+	cells.swap(merged);
+
+	Curve source;
+	combine(source, level + 1);
+	updateActive(level, source);
+	updateActive(level + 1, source);
+	combinedStale = true;
+	return true;
+}
+
+// Level by level: insert the knots the level adds in its cells, then write
+// the coefficients of its active functions. Functions covered by a finer
+// level are overwritten by it, the others carry the truncated coarse part.
+void HierarchicalCurve::combine(Curve& result, int lastLevel) const {
+	const int n = (int)base.knots.size() - base.order;
+	result.order = base.order;
+	result.knots = base.knots;
+	result.controlPoints.assign(std::max(n, 0), glm::vec3(0));
+	result.weights.assign(std::max(n, 0), 1.0f);
+	std::vector<float> knots;
+	for (int l = 0; l <= lastLevel && l < (int)levels.size(); l++) {
+		const Level& level = levels[l];
+		if (l > 0) {
+			// Cells come in pairs, the odd one of each starts at a new knot
+			knots.clear();
+			for (const std::pair<int, int>& range : level.cells) {
+				for (int c = range.first + 1; c < range.second; c += 2) {
+					knots.push_back(levelKnot(l, cellStart(l, c)));
+				}
+			}
+			result.refineKnots(knots);
+		}
+		for (size_t i = 0; i < level.functions.size(); i++) {
+			const int index = combinedIndex(result, l, level.functions[i]);
+			result.controlPoints[index] = level.points[i];
+			result.weights[index] = level.weights[i];
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "Curve.h"
+
+// Storage of a hierarchy next to single B-splines of the same shape
+struct HierarchyMemory {
+	int levels = 0;
+	int activeFunctions = 0;
+	size_t hierarchyBytes = 0;
+	int localPoints = 0;  // one B-spline on the knots of all levels, what local knot insertion gives
+	size_t localBytes = 0;
+	int globalPoints = 0; // every span split down to the finest level
+	size_t globalBytes = 0;
+};
+
+// Truncated hierarchical B-splines (Giannelli, Juettler and Speleers 2012)
+// over the knots of a base curve. Level l splits every span of the base
+// domain into 2^l equal cells, and every level below the first covers a
+// union of refined cells of the level above. A function of a level is active
+// when its support lies inside the level's cells but not inside the next
+// level's, and only active functions store a coefficient. Each function is
+// truncated by dropping its parts along the finer functions that cover it,
+// which keeps partition of unity.
+//
+// Per span the active levels combine into one B-spline: refining the
+// coefficients a level at a time and overwriting those of the level's
+// active functions gives the curve on the knots of all levels. Evaluation
+// and drawing go through that curve, which is rebuilt after a change.
+class HierarchicalCurve {
+
+public:
+	void reset(const Curve& curve);
+	bool empty() const { return levels.empty(); }
+	int levelCount() const { return (int)levels.size(); }
+	int activeCount(int level) const { return (int)levels[level].functions.size(); }
+	// Finest level whose cells hold u
+	int levelAt(float u) const;
+
+	// Refines the cells of a level that overlap [low, high]. The new
+	// functions take over the shape, so the curve stays the same. Returns
+	// false when no cell was refined.
+	bool refine(int level, float low, float high);
+	// Refines the finest cell at u and cells on either side of it
+	bool refineAround(float u, int cells);
+
+	// The active levels combined into one B-spline
+	const Curve& curve() const;
+	bool represents(const Curve& other) const;
+	glm::vec3 evaluate(float u, std::pmr::memory_resource* scratch) const;
+	HierarchyMemory memory() const;
+
+private:
+	struct Level {
+		std::vector<std::pair<int, int>> cells; // ranges [first, last) of the level's cells, sorted and apart
+		std::vector<int> functions;             // first knot of every active function in the level's knots
+		std::vector<glm::vec3> points;
+		std::vector<float> weights;
+	};
+
+	Curve base; // order and knots, the coefficients live in the levels
+	std::vector<Level> levels;
+	std::vector<int> spanStarts;  // base knot of every non-empty span of the domain
+	std::vector<int> spansBefore; // domain spans starting before each base knot
+	mutable Curve combined;
+	mutable bool combinedStale = true;
+
+	// The knots of level l are numbered as if they were stored
+	int levelKnotCount(int level) const;
+	int levelIndex(int level, int baseKnot) const;
+	int baseKnotOf(int level, int index) const;
+	float levelKnot(int level, int index) const;
+	int cellOf(int level, int index) const;
+	int cellStart(int level, int cell) const;
+	int cellAt(int level, float u) const;
+
+	static bool inside(const std::vector<std::pair<int, int>>& cells, int first, int last);
+	bool active(int level, int function) const;
+	int combinedIndex(const Curve& curve, int level, int function) const;
+	void updateActive(int level, const Curve& source);
+	bool refineCells(int level, int first, int last);
+	void combine(Curve& result, int lastLevel) const;
+};
@@ -1,14 +1,35 @@
 #include "InputHandler.h"
 
 RenderEngine* InputHandler::renderEngine;
-int InputHandler::mouseOldX;
-int InputHandler::mouseOldY;
-std::shared_ptr<glm::vec3> InputHandler::mousePos;
+SpscQueue<InputEvent, 4096> InputHandler::events;
+int InputHandler::droppedEvents = 0;
 
 // Must be called before processing any GLFW events
-void InputHandler::setUp(RenderEngine* renderEngine, std::shared_ptr<glm::vec3> pos) {
+void InputHandler::setUp(RenderEngine* renderEngine) {
 	InputHandler::renderEngine = renderEngine;
-	InputHandler::mousePos = pos;
+}
+
+// Timestamps and queues an event for the frame loop to consume
+void InputHandler::pushEvent(InputEventType type, int button, int mods, glm::vec2 position) {
+	if (!events.push({ type, button, mods, position, glfwGetTime() })) {
+		droppedEvents++;
+	}
+}
+
+// Pops the next event in arrival order. With coalesceMotion set a run of
+// motion events collapses into the newest one.
+bool InputHandler::nextEvent(InputEvent& event, bool coalesceMotion) {
+	if (!events.pop(event)) {
+		return false;
+	}
+	if (coalesceMotion && event.type == InputEventType::MouseMove) {
+		const InputEvent* next = events.peek();
+		while (next != nullptr && next->type == InputEventType::MouseMove) {
+			events.pop(event);
+			next = events.peek();
+		}
+	}
+	return true;
 }
 
 // Callback for key presses
@@ -18,40 +39,32 @@ void InputHandler::key(GLFWwindow* window, int key, int scancode, int action, in
 		glfwTerminate();
 		exit(0);
 	}
+	if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+		pushEvent(InputEventType::Key, key, mods, glm::vec2(0));
+	}
 }
 
 // Callback for mouse button presses
 void InputHandler::mouse(GLFWwindow* window, int button, int action, int mods) {
-	if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_1) {
-		mousePos->z = 1.0f;
-	}
-	if (action == GLFW_RELEASE && button == GLFW_MOUSE_BUTTON_1) {
-		mousePos->z = 0.0f;
+	// Record where the click happened, not where the cursor is when it's handled
+	double x, y;
+	glfwGetCursorPos(window, &x, &y);
+	if (action == GLFW_PRESS) {
+		pushEvent(InputEventType::MouseDown, button, mods, glm::vec2(x, y));
 	}
-	if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_2) {
-		mousePos->z = 2.0f;
+	if (action == GLFW_RELEASE) {
+		pushEvent(InputEventType::MouseUp, button, mods, glm::vec2(x, y));
 	}
-	if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_3) {
-		mousePos->z = 3.0f;
-	}
-	if (action == GLFW_RELEASE && button == GLFW_MOUSE_BUTTON_3) {
-		mousePos->z = 0.0f;
-	}
-	// mousePos->x = mouseOldX;
-	// mousePos->y = mouseOldY;
 }
 
 // Callback for mouse motion
 void InputHandler::motion(GLFWwindow* window, double x, double y) {
-	mouseOldX = x;
-	mouseOldY = y;
-
-	mousePos->x = mouseOldX;
-	mousePos->y = mouseOldY;
+	pushEvent(InputEventType::MouseMove, -1, 0, glm::vec2(x, y));
 }
 
 // Callback for mouse scroll
 void InputHandler::scroll(GLFWwindow* window, double x, double y) {
+	pushEvent(InputEventType::Scroll, -1, 0, glm::vec2(x, y));
 }
 
 // Callback for window reshape/resize
@@ -6,11 +6,29 @@
 #include <iostream>
 
 #include "RenderEngine.h"
+#include "SpscQueue.h"
+
+enum class InputEventType {
+	MouseMove,
+	MouseDown,
+	MouseUp,
+	Scroll,
+	Key
+};
+
+// A single input event as delivered by GLFW
+struct InputEvent {
+	InputEventType type;
+	int button;         // mouse button or key, depending on type
+	int mods;
+	glm::vec2 position; // cursor position (window coordinates) or scroll offset
+	double time;        // glfwGetTime() when the callback fired
+};
 
 class InputHandler {
 
 public:
-	static void setUp(RenderEngine* renderEngine, std::shared_ptr<glm::vec3> pos);
+	static void setUp(RenderEngine* renderEngine);
 
 	static void key(GLFWwindow* window, int key, int scancode, int action, int mods);
 	static void mouse(GLFWwindow* window, int button, int action, int mods);
@@ -18,11 +36,13 @@ public:
 	static void scroll(GLFWwindow* window, double x, double y);
 	static void reshape(GLFWwindow* window, int width, int height);
 
+	static bool nextEvent(InputEvent& event, bool coalesceMotion);
+
+	static int droppedEvents;
 
 private:
 	static RenderEngine* renderEngine;
-	static std::shared_ptr<glm::vec3> mousePos;
+	static SpscQueue<InputEvent, 4096> events;
 
-	static int mouseOldX;
-	static int mouseOldY;
+	static void pushEvent(InputEventType type, int button, int mods, glm::vec2 position);
 };
@@ -0,0 +1,243 @@
+#include "KnotRemover.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+
+#include "Parallel.h"
+
+namespace {
+
+const double unremovable = std::numeric_limits<double>::infinity();
+
+}
+
+void KnotRemover::simplify(const std::vector<Curve*>& curves, std::vector<KnotRemovalReport>& reports) const {
+	reports.resize(curves.size());
+	parallelFor((int)curves.size(), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			reports[i] = simplify(*curves[i]);
+		}
+	});
+}
+
+KnotRemovalReport KnotRemover::simplify(Curve& curve) const {
+	KnotRemovalReport report;
+	report.pointsBefore = report.pointsAfter = (int)curve.controlPoints.size();
+	const int degree = curve.order - 1;
+	if ((int)curve.controlPoints.size() <= curve.order || curve.knots.size() != curve.controlPoints.size() + curve.order) {
+		return report;
+	}
+
+	Work work;
+	load(curve, work);
+	work.spanError.assign(work.knots.size() - 1, 0.0);
+	work.bound.assign(work.knots.size(), unremovable);
+	// Homogeneous distances overstate the error of a rational curve, the
+	// limit is scaled down by the smallest weight and the largest point
+	// (NURBS book eq. 5.30)
+	double limit = tolerance;
+	double minWeight = 1;
+	double maxNorm = 0;
+	bool rational = false;
+	for (size_t i = 0; i < curve.controlPoints.size(); i++) {
+		const double weight = curve.weights[i];
+		rational |= weight != 1.0;
+		minWeight = std::min(minWeight, weight);
+		maxNorm = std::max(maxNorm, glm::length(glm::dvec3(curve.controlPoints[i])));
+	}
+	if (rational) {
+		limit = tolerance * minWeight / (1 + maxNorm);
+	}
+	for (int r = degree + 1; r < (int)work.points.size(); r++) {
+		updateBound(work, r);
+	}
+
+	for (;;) {
+		const auto best = std::min_element(work.bound.begin(), work.bound.end());
+		if (*best > limit) {
+			break;
+		}
+		const int r = (int)(best - work.bound.begin());
+		const int s = multiplicity(work, r);
+		// The removal changes the basis functions of points r - degree to
+		// r - s, every span under them takes the bound on top of its error
+		const int firstSpan = r - degree;
+		const int lastSpan = r - s + degree;
+		const double spent = *std::max_element(work.spanError.begin() + firstSpan, work.spanError.begin() + lastSpan + 1);
+		if (spent + *best > limit) {
+			*best = unremovable;
+			continue;
+		}
+		for (int i = firstSpan; i <= lastSpan; i++) {
+			work.spanError[i] += *best;
+		}
+		remove(work, r, s, true);
+		// The spans on either side of the knot become one
+		work.spanError[r - 1] = std::max(work.spanError[r - 1], work.spanError[r]);
+		work.spanError.erase(work.spanError.begin() + r);
+		work.bound.erase(work.bound.begin() + r);
+		// Bounds read points and knots up to degree + 1 away
+		const int low = std::max(r - 2 * degree - 2, 0);
+		const int high = std::min(r + 2 * degree + 2, (int)work.bound.size() - 1);
+		for (int i = low; i <= high; i++) {
+			updateBound(work, i);
+		}
+	}
+
+	if ((int)work.points.size() == report.pointsBefore) {
+		return report;
+	}
+	const Curve before = curve;
+	store(work, curve);
+	report.pointsAfter = (int)curve.controlPoints.size();
+	report.maxError = measureError(before, curve);
+	return report;
+}
+
+// Copies go one at a time from the last one, as long as each moves the
+// curve by at most tolerance in homogeneous space
+int KnotRemover::removeKnots(Curve& curve, const std::vector<float>& values, const std::vector<int>& times) const {
+	if ((int)curve.controlPoints.size() <= curve.order || curve.knots.size() != curve.controlPoints.size() + curve.order) {
+		return 0;
+	}
+	Work work;
+	load(curve, work);
+	int removed = 0;
+	for (size_t k = 0; k < values.size(); k++) {
+		for (int t = 0; t < times[k]; t++) {
+			const auto copy = std::upper_bound(work.knots.begin(), work.knots.end(), (double)values[k]);
+			const int r = (int)(copy - work.knots.begin()) - 1;
+			if (r <= work.degree || r >= (int)work.points.size() || work.knots[r] != values[k]) {
+				break;
+			}
+			const int s = multiplicity(work, r);
+			if (remove(work, r, s, false) > tolerance) {
+				break;
+			}
+			remove(work, r, s, true);
+			removed++;
+		}
+	}
+	if (removed > 0) {
+		store(work, curve);
+	}
+	return removed;
+}
+
+void KnotRemover::load(const Curve& curve, Work& work) {
+	work.degree = curve.order - 1;
+	work.knots.assign(curve.knots.begin(), curve.knots.end());
+	work.points.clear();
+	for (size_t i = 0; i < curve.controlPoints.size(); i++) {
+		const double weight = curve.weights[i];
+		work.points.push_back(glm::dvec4(glm::dvec3(curve.controlPoints[i]) * weight, weight));
+	}
+}
+
+void KnotRemover::store(const Work& work, Curve& curve) {
+	curve.controlPoints.resize(work.points.size());
+	curve.weights.resize(work.points.size());
+	for (size_t i = 0; i < work.points.size(); i++) {
+		curve.weights[i] = (float)work.points[i].w;
+		curve.controlPoints[i] = glm::vec3(glm::dvec3(work.points[i]) / work.points[i].w);
+	}
+	curve.knots.assign(work.knots.begin(), work.knots.end());
+}
+
+int KnotRemover::multiplicity(const Work& work, int r) {
+	int s = 1;
+	while (r - s >= 0 && work.knots[r - s] == work.knots[r]) {
+		s++;
+	}
+	return s;
+}
+
+// Only the last copy of an interior knot with a smooth enough joint is a candidate
+void KnotRemover::updateBound(Work& work, int r) {
+	const int degree = work.degree;
+	const int count = (int)work.points.size();
+	work.bound[r] = unremovable;
+	if (r <= degree || r >= count || work.knots[r] == work.knots[r + 1]) {
+		return;
+	}
+	const int s = multiplicity(work, r);
+	if (s > degree) {
+		return;
+	}
+	work.bound[r] = remove(work, r, s, false);
+}
+
+// Removes one copy of knot r with multiplicity s. The new points are solved
+// for from both ends of the affected range towards the middle, where they
+// should agree; how far apart they end up is the bound on the change of the
+// curve (NURBS book A5.8). Without apply only the bound is computed.
+double KnotRemover::remove(Work& work, int r, int s, bool apply) {
+	const int degree = work.degree;
+	const std::vector<double>& knots = work.knots;
+	std::vector<glm::dvec4>& points = work.points;
+	std::vector<glm::dvec4>& temp = work.temp;
+	const double u = knots[r];
+	const int first = r - degree;
+	const int last = r - s;
+	const int off = first - 1;
+	temp.resize(last - off + 2);
+	temp[0] = points[off];
+	temp[last + 1 - off] = points[last + 1];
+	int i = first;
+	int j = last;
+	int ii = 1;
+	int jj = last - off;
+	while (j - i > 0) {
+		const double alphaI = (u - knots[i]) / (knots[i + degree + 1] - knots[i]);
+		const double alphaJ = (u - knots[j]) / (knots[j + degree + 1] - knots[j]);
+		temp[ii] = (points[i] - (1 - alphaI) * temp[ii - 1]) / alphaI;
+		temp[jj] = (points[j] - alphaJ * temp[jj + 1]) / (1 - alphaJ);
+		i++;
+		ii++;
+		j--;
+		jj--;
+	}
+	double bound;
+	if (j - i < 0) {
+		bound = glm::distance(temp[ii - 1], temp[jj + 1]);
+	}
+	else {
+		const double alphaI = (u - knots[i]) / (knots[i + degree + 1] - knots[i]);
+		bound = glm::distance(points[i], alphaI * temp[ii + 1] + (1 - alphaI) * temp[ii - 1]);
+	}
+	if (!apply) {
+		return bound;
+	}
+
+	for (i = first, j = last; j - i > 0; i++, j--) {
+		points[i] = temp[i - off];
+		points[j] = temp[j - off];
+	}
+	points.erase(points.begin() + (2 * r - s - degree) / 2);
+	work.knots.erase(work.knots.begin() + r);
+	return bound;
+}
+
+// Both curves share the domain and keep the parameterization, so the
+// distance at equal parameters over every old span is the deviation
+float KnotRemover::measureError(const Curve& before, const Curve& after) const {
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	float error = 0;
+	for (int delta = before.order - 1; delta < (int)before.controlPoints.size(); delta++) {
+		const float low = before.knots[delta];
+		const float high = before.knots[delta + 1];
+		if (low == high) {
+			continue;
+		}
+		for (int k = 0; k <= errorSamplesPerSpan; k++) {
+			const float u = low + (high - low) * k / errorSamplesPerSpan;
+			const glm::vec3 a = before.evaluate(delta, u, &pool);
+			const glm::vec3 b = after.evaluate(after.findSpan(u), u, &pool);
+			error = std::max(error, glm::distance(a, b));
+		}
+	}
+	return error;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Curve.h"
+
+// What simplifying one curve did
+struct KnotRemovalReport {
+	int pointsBefore = 0;
+	int pointsAfter = 0;
+	float maxError = 0; // largest distance between the old and new curve at the same parameter, measured
+};
+
+// Toleranced knot removal (Tiller, NURBS book A5.8 and 9.4.4). Every
+// interior knot gets a bound on how far its removal moves the curve, and
+// the knot with the smallest bound goes first as long as the errors already
+// spent on the spans it touches leave room for it. The bounds only change
+// near a removed knot, so only those are recomputed. The work is done on a
+// double precision copy in homogeneous form, the curve is written once at
+// the end. Curves of a scene are independent and run on the worker threads.
+class KnotRemover {
+
+public:
+	float tolerance = 1e-3f; // curve space
+	int errorSamplesPerSpan = 32;
+
+	KnotRemovalReport simplify(Curve& curve) const;
+	void simplify(const std::vector<Curve*>& curves, std::vector<KnotRemovalReport>& reports) const;
+	// Removes up to times[k] copies of knot values[k], values increasing.
+	// Returns the number of copies that went.
+	int removeKnots(Curve& curve, const std::vector<float>& values, const std::vector<int>& times) const;
+
+private:
+	struct Work {
+		int degree = 0;
+		std::vector<glm::dvec4> points;
+		std::vector<double> knots;
+		std::vector<double> spanError; // error spent on the span starting at each knot
+		std::vector<double> bound;     // removal bound of the last copy of each interior knot
+		std::vector<glm::dvec4> temp;
+	};
+
+	static void load(const Curve& curve, Work& work);
+	static void store(const Work& work, Curve& curve);
+	static int multiplicity(const Work& work, int r);
+	static void updateBound(Work& work, int r);
+	static double remove(Work& work, int r, int s, bool apply);
+	float measureError(const Curve& before, const Curve& after) const;
+};
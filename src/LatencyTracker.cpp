@@ -0,0 +1,74 @@
+#include "LatencyTracker.h"
+
+LatencyTracker::LatencyTracker() {
+	std::fill(stageTimes, stageTimes + StageCount, 0.0);
+	std::fill(stageAverages, stageAverages + StageCount, 0.0f);
+	nextSample = 0;
+	samples.reserve(maxSamples);
+}
+
+// Record when the current frame reached a stage, in glfwGetTime() seconds
+void LatencyTracker::mark(Stage stage, double time) {
+	stageTimes[stage] = time;
+}
+
+// An event that arrived at arrivalTime changed what this frame will show
+void LatencyTracker::inputApplied(double arrivalTime) {
+	pendingInputs.push_back(arrivalTime);
+}
+
+// Call after the Presented mark, turns the frame's inputs into samples
+void LatencyTracker::endFrame() {
+	if (pendingInputs.empty()) {
+		return;
+	}
+	for (double arrival : pendingInputs) {
+		const float latency = (float)(stageTimes[Presented] - arrival) * 1000.0f;
+		if (samples.size() < maxSamples) {
+			samples.push_back(latency);
+		}
+		else {
+			samples[nextSample] = latency;
+		}
+		nextSample = (nextSample + 1) % maxSamples;
+	}
+
+	// Stage breakdown relative to the start of the frame, only for frames with input
+	for (int s = 0; s < StageCount; s++) {
+		const float elapsed = (float)(stageTimes[s] - stageTimes[FrameStart]) * 1000.0f;
+		stageAverages[s] += 0.1f * (elapsed - stageAverages[s]);
+	}
+	pendingInputs.clear();
+}
+
+int LatencyTracker::sampleCount() const {
+	return samples.size();
+}
+
+// Latency in milliseconds below which the given fraction of samples fall
+float LatencyTracker::percentile(float fraction) const {
+	if (samples.empty()) {
+		return 0;
+	}
+	sorted = samples;
+	const int index = std::min((int)(fraction * sorted.size()), (int)sorted.size() - 1);
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+// Average milliseconds from the start of the frame to the given stage
+float LatencyTracker::stageTime(Stage stage) const {
+	return stageAverages[stage];
+}
+
+// Buckets the samples evenly between 0 and maxLatency, larger values go in the last bin
+void LatencyTracker::histogram(std::vector<float>& bins, float maxLatency) const {
+	std::fill(bins.begin(), bins.end(), 0.0f);
+	if (bins.empty()) {
+		return;
+	}
+	for (float latency : samples) {
+		const int bin = std::clamp((int)(latency / maxLatency * bins.size()), 0, (int)bins.size() - 1);
+		bins[bin] += 1.0f;
+	}
+}
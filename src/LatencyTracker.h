@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+// Measures the time from an input event being received to the frame that
+// shows its effect being presented, with a per-stage breakdown.
+class LatencyTracker {
+
+public:
+	enum Stage {
+		FrameStart,   // about to call glfwPollEvents
+		Polled,       // glfwPollEvents returned
+		InputApplied, // queued events consumed and control points updated
+		Tessellated,  // curve re-evaluated
+		Submitted,    // draw calls issued, about to swap
+		Presented,    // glfwSwapBuffers returned
+		StageCount
+	};
+
+	LatencyTracker();
+
+	void mark(Stage stage, double time);
+	void inputApplied(double arrivalTime);
+	void endFrame();
+
+	int sampleCount() const;
+	float percentile(float fraction) const;
+	float stageTime(Stage stage) const;
+	void histogram(std::vector<float>& bins, float maxLatency) const;
+
+private:
+	static const int maxSamples = 1024;
+
+	double stageTimes[StageCount];
+	float stageAverages[StageCount];
+	std::vector<double> pendingInputs;
+
+	// Ring buffer of the latest latencies in milliseconds
+	std::vector<float> samples;
+	int nextSample;
+	mutable std::vector<float> sorted;
+};
@@ -0,0 +1,190 @@
+#include "LeastSquaresFitter.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LeastSquaresFitter::begin(int order, int controlPointCount) {
+	this->order = order;
+	this->controlPointCount = controlPointCount;
+	fit = Curve();
+	fit.order = order;
+	measured = 0;
+	totalLength = 0;
+	lengthSamples.clear();
+	lengthStride = 1;
+	walked = 0;
+	travelled = 0;
+	normals.resize(0, 0);
+	rhs.clear();
+	checked = 0;
+	squaredErrorSum = 0;
+	maxError = 0;
+}
+
+int LeastSquaresFitter::pointCount() const {
+	return measured;
+}
+
+double LeastSquaresFitter::rmsError() const {
+	return checked > 0 ? std::sqrt(squaredErrorSum / checked) : 0.0;
+}
+
+void LeastSquaresFitter::measure(const glm::vec3* points, int count) {
+	for (int i = 0; i < count; i++) {
+		if (measured == 0) {
+			first = points[i];
+		}
+		else {
+			totalLength += glm::distance(last, points[i]);
+		}
+		last = points[i];
+		if (measured % lengthStride == 0) {
+			if (lengthSamples.size() == maxLengthSamples) {
+				// Keep every other sample, the stride is now twice as long
+				for (size_t s = 0; s < maxLengthSamples / 2; s++) {
+					lengthSamples[s] = lengthSamples[2 * s];
+				}
+				lengthSamples.resize(maxLengthSamples / 2);
+				lengthStride *= 2;
+			}
+			if (measured % lengthStride == 0) {
+				lengthSamples.push_back(totalLength);
+			}
+		}
+		measured++;
+	}
+}
+
+// Normalized chord length at a fractional point index, interpolated between the kept samples
+float LeastSquaresFitter::parameterOf(double pointIndex) const {
+	const int lastIndex = measured - 1;
+	if (totalLength <= 0.0) {
+		return (float)(pointIndex / lastIndex);
+	}
+	const double sample = pointIndex / lengthStride;
+	const int below = std::min((int)sample, (int)lengthSamples.size() - 1);
+	const double belowIndex = (double)below * lengthStride;
+	const double aboveIndex = below + 1 < (int)lengthSamples.size() ? belowIndex + lengthStride : (double)lastIndex;
+	const double aboveLength = below + 1 < (int)lengthSamples.size() ? lengthSamples[below + 1] : totalLength;
+	const double t = aboveIndex > belowIndex ? std::clamp((pointIndex - belowIndex) / (aboveIndex - belowIndex), 0.0, 1.0) : 0.0;
+	return (float)((lengthSamples[below] + t * (aboveLength - lengthSamples[below])) / totalLength);
+}
+
+// Interior knots average the parameters around them (NURBS book 9.68), so
+// every knot span holds data and the normal equations stay positive definite
+void LeastSquaresFitter::placeKnots() {
+	const int degree = order - 1;
+	const int n = controlPointCount - 1;
+	const int m = measured - 1;
+	fit.controlPoints.assign(controlPointCount, glm::vec3(0));
+	fit.weights.assign(controlPointCount, 1.0f);
+	fit.knots.assign(controlPointCount + order, 0.0f);
+	const double d = (double)(m + 1) / (n - degree + 1);
+	for (int j = 1; j <= n - degree; j++) {
+		const double position = j * d;
+		const int i = (int)position;
+		const double alpha = position - i;
+		fit.knots[degree + j] = (float)((1.0 - alpha) * parameterOf(i - 1) + alpha * parameterOf(i));
+	}
+	for (int j = n + 1; j < controlPointCount + order; j++) {
+		fit.knots[j] = 1.0f;
+	}
+	normals.resize(std::max(n - 1, 0), degree);
+	rhs.assign(std::max(n - 1, 0), glm::dvec3(0));
+}
+
+float LeastSquaresFitter::nextParameter(glm::vec3 point) {
+	if (walked > 0) {
+		travelled += glm::distance(previous, point);
+	}
+	previous = point;
+	const int lastIndex = measured - 1;
+	const float u = totalLength > 0.0 ? (float)(travelled / totalLength) : (float)walked / lastIndex;
+	walked++;
+	return std::min(u, 1.0f);
+}
+
+void LeastSquaresFitter::accumulate(const glm::vec3* points, int count) {
+	const int degree = order - 1;
+	const int n = controlPointCount - 1;
+	if (order < 2 || n < degree || measured <= n) {
+		return;
+	}
+	if (walked == 0) {
+		placeKnots();
+	}
+	std::pmr::unsynchronized_pool_resource pool;
+	std::vector<float> basis(order);
+	for (int k = 0; k < count && walked < measured; k++) {
+		const float u = nextParameter(points[k]);
+		const int delta = fit.findSpan(u);
+		fit.basisDerivatives(delta, u, 0, basis.data(), &pool);
+		// The end points are fixed, their share of the point moves to the right hand side
+		glm::dvec3 remainder = glm::dvec3(points[k]);
+		for (int a = 0; a < order; a++) {
+			const int row = delta - degree + a;
+			if (row == 0) {
+				remainder -= (double)basis[a] * glm::dvec3(first);
+			}
+			else if (row == n) {
+				remainder -= (double)basis[a] * glm::dvec3(last);
+			}
+		}
+		for (int a = 0; a < order; a++) {
+			const int row = delta - degree + a;
+			if (row < 1 || row > n - 1) {
+				continue;
+			}
+			rhs[row - 1] += (double)basis[a] * remainder;
+			for (int b = 0; b <= a; b++) {
+				const int column = delta - degree + b;
+				if (column >= 1) {
+					normals.at(row - 1, column - 1) += (double)basis[a] * basis[b];
+				}
+			}
+		}
+	}
+}
+
+bool LeastSquaresFitter::solve(Curve& curve) {
+	const int n = controlPointCount - 1;
+	if (walked != measured || measured <= n || fit.knots.empty()) {
+		return false;
+	}
+	if (n > 1) {
+		if (!normals.factorize()) {
+			return false;
+		}
+		normals.solve(rhs.data());
+	}
+	fit.controlPoints.front() = first;
+	fit.controlPoints.back() = last;
+	for (int i = 1; i < n; i++) {
+		fit.controlPoints[i] = glm::vec3(rhs[i - 1]);
+	}
+	curve.order = fit.order;
+	curve.controlPoints = fit.controlPoints;
+	curve.weights = fit.weights;
+	curve.knots = fit.knots;
+	// The check pass walks the data once more
+	walked = 0;
+	travelled = 0;
+	checked = 0;
+	squaredErrorSum = 0;
+	maxError = 0;
+	return true;
+}
+
+void LeastSquaresFitter::checkError(const glm::vec3* points, int count) {
+	if (fit.knots.empty() || walked >= measured) {
+		return;
+	}
+	std::pmr::unsynchronized_pool_resource pool;
+	for (int k = 0; k < count && walked < measured; k++) {
+		const float u = nextParameter(points[k]);
+		const double distance = glm::distance(fit.evaluate(fit.findSpan(u), u, &pool), points[k]);
+		maxError = std::max(maxError, distance);
+		squaredErrorSum += distance * distance;
+		checked++;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory_resource>
+#include <vector>
+
+#include "BandMatrix.h"
+#include "Curve.h"
+
+// Least squares approximation of an ordered point stream by a B-spline
+// with a chosen order and number of control points (NURBS book 9.4.1). The
+// end points are interpolated and the rest minimize the squared distance
+// to the data. The data is read in two passes of chunks: the first
+// measures the chord length parameterization, the second adds every point
+// straight into the banded normal equations. Neither the data nor the
+// design matrix is ever held in full.
+class LeastSquaresFitter {
+
+public:
+	// Starts a new fit, the previous state is dropped
+	void begin(int order, int controlPointCount);
+	// First pass over the data
+	void measure(const glm::vec3* points, int count);
+	// Second pass, the same points in the same order
+	void accumulate(const glm::vec3* points, int count);
+	// Banded Cholesky solve, writes order, knots, control points and unit weights
+	bool solve(Curve& curve);
+	// Optional third pass, distances between the data and the solved curve
+	void checkError(const glm::vec3* points, int count);
+
+	int pointCount() const;
+	double maxError = 0;
+	double rmsError() const;
+
+private:
+	int order = 0;
+	int controlPointCount = 0;
+	Curve fit; // knots and, once solved, control points of the result
+
+	// Measure pass. Cumulative chord length is kept for every stride-th
+	// point only, the stride doubles whenever too many have piled up.
+	static constexpr int maxLengthSamples = 1 << 16;
+	int measured = 0;
+	double totalLength = 0;
+	glm::vec3 first = glm::vec3(0);
+	glm::vec3 last = glm::vec3(0);
+	std::vector<double> lengthSamples;
+	int lengthStride = 1;
+
+	// Accumulate and check passes walk the data again
+	int walked = 0;
+	double travelled = 0;
+	glm::vec3 previous = glm::vec3(0);
+	SymmetricBandMatrix normals; // rows of the interior control points 1 .. n-1
+	std::vector<glm::dvec3> rhs;
+	int checked = 0;
+	double squaredErrorSum = 0;
+
+	void placeKnots();
+	float parameterOf(double pointIndex) const;
+	float nextParameter(glm::vec3 point);
+};
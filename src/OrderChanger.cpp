@@ -0,0 +1,255 @@
+#include "OrderChanger.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "KnotRemover.h"
+#include "Parallel.h"
+
+namespace {
+
+double binomial(int n, int k) {
+	double result = 1;
+	for (int i = 1; i <= k; i++) {
+		result = result * (n - k + i) / i;
+	}
+	return result;
+}
+
+}
+
+// Q[i] = sum of C(degree, j) C(times, i - j) / C(degree + times, i) P[j]
+// (NURBS book eq. 5.36)
+const std::vector<double>& OrderChanger::elevationTable(int degree, int times) {
+	std::vector<double>& table = elevationTables[{ degree, times }];
+	if (!table.empty()) {
+		return table;
+	}
+	const int elevated = degree + times;
+	table.assign((elevated + 1) * (degree + 1), 0.0);
+	for (int i = 0; i <= elevated; i++) {
+		const double inverse = 1 / binomial(elevated, i);
+		for (int j = std::max(0, i - times); j <= std::min(degree, i); j++) {
+			table[i * (degree + 1) + j] = inverse * binomial(degree, j) * binomial(times, i - j);
+		}
+	}
+	return table;
+}
+
+// Elevating the reduced points back must give the original ones. Solving
+// that from the first point forwards and from the last point backwards
+// keeps both ends, the solutions meet in the middle where an odd degree
+// averages the point both of them reach. Both maps are linear in the
+// points, so they are stored as matrices found from the unit vectors.
+const OrderChanger::ReductionTable& OrderChanger::reductionTable(int degree) {
+	ReductionTable& table = reductionTables[degree];
+	if (!table.reduce.empty()) {
+		return table;
+	}
+	const int count = degree + 1;
+	const int left = (degree - 1) / 2;
+	const int right = degree - 1 - left;
+	table.reduce.assign(degree * count, 0.0);
+	std::vector<double> forward(degree);
+	std::vector<double> backward(degree);
+	for (int column = 0; column < count; column++) {
+		std::vector<double> points(count, 0.0);
+		points[column] = 1;
+		forward[0] = points[0];
+		for (int i = 1; i <= left; i++) {
+			const double alpha = (double)i / degree;
+			forward[i] = (points[i] - alpha * forward[i - 1]) / (1 - alpha);
+		}
+		backward[degree - 1] = points[degree];
+		for (int i = degree - 1; i > right; i--) {
+			const double alpha = (double)i / degree;
+			backward[i - 1] = (points[i] - (1 - alpha) * backward[i]) / alpha;
+		}
+		for (int i = 0; i < degree; i++) {
+			double value = i < right ? forward[i] : backward[i];
+			if (i == left && left == right) {
+				value = 0.5 * (forward[i] + backward[i]);
+			}
+			table.reduce[i * count + column] = value;
+		}
+	}
+	// Elevated back Q[i] = i / degree P[i - 1] + (1 - i / degree) P[i]
+	table.error.assign(count * count, 0.0);
+	for (int i = 0; i < count; i++) {
+		const double alpha = (double)i / degree;
+		for (int column = 0; column < count; column++) {
+			double value = i == column ? -1.0 : 0.0;
+			if (i > 0) {
+				value += alpha * table.reduce[(i - 1) * count + column];
+			}
+			if (i < degree) {
+				value += (1 - alpha) * table.reduce[i * count + column];
+			}
+			table.error[i * count + column] = value;
+		}
+	}
+	return table;
+}
+
+bool OrderChanger::elevate(Curve& curve, int times) {
+	if (times <= 0) {
+		return times == 0;
+	}
+	elevationTable(curve.order - 1, times);
+	return elevateCurve(curve, times);
+}
+
+bool OrderChanger::reduce(Curve& curve) {
+	if (curve.order <= 2) {
+		return false;
+	}
+	reductionTable(curve.order - 1);
+	return reduceCurve(curve, tolerance, maxError);
+}
+
+int OrderChanger::unify(const std::vector<Curve*>& curves, int order) {
+	// The tables are filled in up front, the threads only read them
+	for (const Curve* curve : curves) {
+		if (curve->order < order) {
+			elevationTable(curve->order - 1, order - curve->order);
+		}
+		for (int degree = curve->order - 1; degree >= order; degree--) {
+			reductionTable(degree);
+		}
+	}
+	std::vector<float> errors(curves.size(), 0.0f);
+	parallelFor((int)curves.size(), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			Curve& curve = *curves[i];
+			if (curve.order < order) {
+				elevateCurve(curve, order - curve.order);
+			}
+			float error = 0;
+			while (curve.order > order && reduceCurve(curve, tolerance - errors[i], error)) {
+				errors[i] += error;
+			}
+		}
+	});
+	maxError = 0;
+	int unified = 0;
+	for (size_t i = 0; i < curves.size(); i++) {
+		maxError = std::max(maxError, errors[i]);
+		unified += curves[i]->order == order;
+	}
+	return unified;
+}
+
+// The Bezier segments elevated one after another make a curve with every
+// interior knot at full multiplicity, removing the copies the curve had
+// fewer of gives back its continuity. Those removals are exact.
+bool OrderChanger::elevateCurve(Curve& curve, int times) const {
+	std::vector<glm::vec4> bezier;
+	std::vector<float> breakpoints;
+	curve.decomposeBezier(bezier, &breakpoints);
+	if (bezier.empty()) {
+		return false;
+	}
+	const int degree = curve.order - 1;
+	const int elevated = degree + times;
+	const int segments = (int)breakpoints.size() - 1;
+	const std::vector<double>& table = elevationTables.at({ degree, times });
+	std::vector<int> removals(breakpoints.size(), 0);
+	for (int k = 1; k < segments; k++) {
+		removals[k] = degree - curve.knotMultiplicity(breakpoints[k]);
+	}
+
+	std::vector<glm::vec4> points;
+	points.reserve(segments * elevated + 1);
+	for (int s = 0; s < segments; s++) {
+		const glm::vec4* segment = bezier.data() + s * curve.order;
+		for (int i = s == 0 ? 0 : 1; i <= elevated; i++) {
+			glm::dvec4 point(0);
+			for (int j = std::max(0, i - times); j <= std::min(degree, i); j++) {
+				point += table[i * curve.order + j] * glm::dvec4(segment[j]);
+			}
+			points.push_back(glm::vec4(point));
+		}
+	}
+	curve.order = elevated + 1;
+	curve.knots.assign(curve.order, breakpoints.front());
+	for (int k = 1; k < segments; k++) {
+		curve.knots.insert(curve.knots.end(), elevated, breakpoints[k]);
+	}
+	curve.knots.insert(curve.knots.end(), curve.order, breakpoints.back());
+	curve.setHomogeneousPoints(points);
+	KnotRemover remover;
+	remover.tolerance = std::numeric_limits<float>::max();
+	remover.removeKnots(curve, breakpoints, removals);
+	return true;
+}
+
+// The error table gives the change of each segment as Bezier points, which
+// bound the change of the curve. Homogeneous distances of a rational curve
+// are scaled as in KnotRemover. A failed reduction reports the change of
+// the first segment that didn't fit.
+bool OrderChanger::reduceCurve(Curve& curve, float allowed, float& error) const {
+	std::vector<glm::vec4> bezier;
+	std::vector<float> breakpoints;
+	curve.decomposeBezier(bezier, &breakpoints);
+	if (bezier.empty() || curve.order <= 2) {
+		return false;
+	}
+	const int degree = curve.order - 1;
+	const int count = curve.order;
+	const int segments = (int)breakpoints.size() - 1;
+	const ReductionTable& table = reductionTables.at(degree);
+	double scale = 1;
+	bool rational = false;
+	double minWeight = 1;
+	double maxNorm = 0;
+	for (size_t i = 0; i < curve.controlPoints.size(); i++) {
+		rational |= curve.weights[i] != 1.0f;
+		minWeight = std::min(minWeight, (double)curve.weights[i]);
+		maxNorm = std::max(maxNorm, (double)glm::length(curve.controlPoints[i]));
+	}
+	if (rational) {
+		scale = (1 + maxNorm) / minWeight;
+	}
+
+	std::vector<glm::vec4> points;
+	points.reserve(segments * (degree - 1) + 1);
+	double worst = 0;
+	for (int s = 0; s < segments; s++) {
+		const glm::vec4* segment = bezier.data() + s * count;
+		for (int i = 0; i < count; i++) {
+			glm::dvec4 change(0);
+			for (int j = 0; j < count; j++) {
+				change += table.error[i * count + j] * glm::dvec4(segment[j]);
+			}
+			worst = std::max(worst, glm::length(change) * scale);
+		}
+		if (worst > allowed) {
+			error = (float)worst;
+			return false;
+		}
+		for (int i = s == 0 ? 0 : 1; i < degree; i++) {
+			glm::dvec4 point(0);
+			for (int j = 0; j < count; j++) {
+				point += table.reduce[i * count + j] * glm::dvec4(segment[j]);
+			}
+			points.push_back(glm::vec4(point));
+		}
+	}
+
+	Curve reduced;
+	reduced.order = degree;
+	reduced.knots.assign(reduced.order, breakpoints.front());
+	for (int k = 1; k < segments; k++) {
+		reduced.knots.insert(reduced.knots.end(), degree - 1, breakpoints[k]);
+	}
+	reduced.knots.insert(reduced.knots.end(), reduced.order, breakpoints.back());
+	reduced.setHomogeneousPoints(points);
+	error = (float)worst;
+	if (error < allowed) {
+		KnotRemover remover;
+		remover.tolerance = allowed - error;
+		error += remover.simplify(reduced).maxError;
+	}
+	curve = reduced;
+	return true;
+}
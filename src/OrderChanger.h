@@ -0,0 +1,45 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Curve.h"
+
+// Changes of order that keep the shape, unlike editing curve.order which
+// reads the same control points as a different curve. The curve is split
+// into Bezier segments, every segment goes through a coefficient table for
+// its degree, and the segments are joined back into a B-spline by knot
+// removal. Elevation is exact and keeps the continuity at every knot.
+// Reduction fits each segment from both ends (NURBS book 5.6), fails when a
+// segment moves by more than the tolerance, and spends what is left of the
+// tolerance on removing the knots between the segments again.
+class OrderChanger {
+
+public:
+	float tolerance = 1e-3f; // curve space, for reduction
+	float maxError = 0;      // last reduction, or worst curve of the last unify
+
+	bool elevate(Curve& curve, int times = 1);
+	bool reduce(Curve& curve);
+	// Every curve brought to the given order on the worker threads. Curves
+	// that can't be reduced far enough keep the order they got down to.
+	// Returns the number of curves with the order.
+	int unify(const std::vector<Curve*>& curves, int order);
+
+private:
+	// Reduced segment points from the points of degree, and the change of
+	// the segment from them when elevated back
+	struct ReductionTable {
+		std::vector<double> reduce; // degree x (degree + 1)
+		std::vector<double> error;  // (degree + 1) x (degree + 1)
+	};
+
+	std::map<std::pair<int, int>, std::vector<double>> elevationTables; // by degree and times
+	std::map<int, ReductionTable> reductionTables;                     // by degree
+
+	const std::vector<double>& elevationTable(int degree, int times);
+	const ReductionTable& reductionTable(int degree);
+	bool elevateCurve(Curve& curve, int times) const;
+	bool reduceCurve(Curve& curve, float allowed, float& error) const;
+};
@@ -0,0 +1,162 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+thread_local bool insideParallel = false;
+
+// Workers sleep until a job is published, then race for its chunks
+class WorkerPool {
+
+public:
+	WorkerPool() {
+		const int workers = std::max((int)std::thread::hardware_concurrency(), 1) - 1;
+		for (int i = 0; i < workers; i++) {
+			threads.emplace_back([this] { work(); });
+		}
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+
+	int size() const {
+		return (int)threads.size() + 1;
+	}
+
+	void run(int count, int grain, const std::function<void(int, int)>& body) {
+		std::lock_guard<std::mutex> serial(submit);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &body;
+			jobCount = count;
+			jobGrain = grain;
+			nextChunk.store(0);
+			busy = (int)threads.size();
+			generation++;
+		}
+		wake.notify_all();
+		runChunks(body, count, grain);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busy == 0; });
+		job = nullptr;
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex submit; // one job at a time
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int, int)>* job = nullptr;
+	int jobCount = 0;
+	int jobGrain = 1;
+	std::atomic<int> nextChunk{ 0 };
+	int busy = 0;
+	unsigned generation = 0;
+	bool stopping = false;
+
+	void runChunks(const std::function<void(int, int)>& body, int count, int grain) {
+		insideParallel = true;
+		for (;;) {
+			const int begin = nextChunk.fetch_add(grain);
+			if (begin >= count) {
+				break;
+			}
+			body(begin, std::min(begin + grain, count));
+		}
+		insideParallel = false;
+	}
+
+	void work() {
+		unsigned seen = 0;
+		for (;;) {
+			const std::function<void(int, int)>* body;
+			int count;
+			int grain;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = generation;
+				body = job;
+				count = jobCount;
+				grain = jobGrain;
+			}
+			runChunks(*body, count, grain);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busy--;
+			}
+			done.notify_one();
+		}
+	}
+};
+
+WorkerPool& pool() {
+	static WorkerPool workers;
+	return workers;
+}
+
+}
+
+void parallelFor(int count, int grain, const std::function<void(int begin, int end)>& body) {
+	grain = std::max(grain, 1);
+	if (count <= 0) {
+		return;
+	}
+	// Small jobs and nested calls aren't worth waking anyone for
+	if (count <= grain || insideParallel || pool().size() == 1) {
+		body(0, count);
+		return;
+	}
+	pool().run(count, grain, body);
+}
+
+int parallelThreads() {
+	return pool().size();
+}
+
+void parallelExclusiveScan(const double* values, double* out, int count) {
+	const int blocks = std::max(std::min(parallelThreads() * 4, count / 4096), 1);
+	const int blockSize = (count + blocks - 1) / std::max(blocks, 1);
+	std::vector<double> blockSums(blocks + 1, 0.0);
+	// Sum every block, scan the block sums, then scan inside each block from its offset
+	parallelFor(blocks, 1, [&](int begin, int end) {
+		for (int block = begin; block < end; block++) {
+			double sum = 0;
+			for (int i = block * blockSize; i < std::min((block + 1) * blockSize, count); i++) {
+				sum += values[i];
+			}
+			blockSums[block + 1] = sum;
+		}
+	});
+	for (int block = 1; block <= blocks; block++) {
+		blockSums[block] += blockSums[block - 1];
+	}
+	parallelFor(blocks, 1, [&](int begin, int end) {
+		for (int block = begin; block < end; block++) {
+			double sum = blockSums[block];
+			for (int i = block * blockSize; i < std::min((block + 1) * blockSize, count); i++) {
+				out[i] = sum;
+				sum += values[i];
+			}
+		}
+	});
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+
+// Runs body over [0, count) split into chunks of at least grain items, on a
+// pool of worker threads shared by the whole program. The calling thread
+// takes chunks too and returns once every chunk is done. Calls made from
+// inside a body run serially instead of waiting on the pool.
+void parallelFor(int count, int grain, const std::function<void(int begin, int end)>& body);
+
+// Number of threads parallelFor spreads work over, the caller included
+int parallelThreads();
+
+// out[i] = sum of values[0 .. i-1], two passes over the data in parallel
+void parallelExclusiveScan(const double* values, double* out, int count);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Immutable array stored as a radix tree of shared, copy-on-write chunks.
+// Every modification returns a new version that shares all untouched
+// chunks with the old one, so keeping many versions around is cheap and
+// any version can be read from other threads without locking.
+template <typename T>
+class PersistentArray {
+
+public:
+	static const size_t leafSize = 64;
+	static const size_t branching = 32;
+
+	PersistentArray() : count(0), height(0), allocatedBytes(0) {}
+
+	size_t size() const {
+		return count;
+	}
+
+	const T& operator[](size_t index) const {
+		const size_t leaf = index / leafSize;
+		const Node* node = root.get();
+		for (int level = height; level > 0; level--) {
+			node = node->children[(leaf / leavesUnder(level - 1)) % branching].get();
+		}
+		return node->values[index % leafSize];
+	}
+
+	// New version with one element replaced, copies one chunk per tree level
+	PersistentArray set(size_t index, const T& value) const {
+		PersistentArray result = *this;
+		result.allocatedBytes = 0;
+		result.root = setIn(root, height, index, value, result.allocatedBytes);
+		return result;
+	}
+
+	void copyTo(std::vector<T>& values) const {
+		values.clear();
+		values.reserve(count);
+		appendFrom(root.get(), height, values);
+	}
+
+	// Builds a version holding values that reuses every chunk of previous
+	// whose contents are unchanged
+	static PersistentArray fromVector(const std::vector<T>& values, const PersistentArray& previous) {
+		PersistentArray result;
+		result.count = values.size();
+		if (values.empty()) {
+			return result;
+		}
+
+		// Leaves first, reusing the previous leaf at the same position if equal
+		std::vector<NodePtr> level;
+		for (size_t first = 0; first < values.size(); first += leafSize) {
+			const size_t last = std::min(first + leafSize, values.size());
+			const NodePtr old = previous.nodeAt(0, first / leafSize);
+			if (old != nullptr && old->values.size() == last - first &&
+				std::equal(values.begin() + first, values.begin() + last, old->values.begin())) {
+				level.push_back(old);
+				continue;
+			}
+			std::shared_ptr<Node> leaf = std::make_shared<Node>();
+			leaf->values.assign(values.begin() + first, values.begin() + last);
+			result.allocatedBytes += sizeof(Node) + leaf->values.size() * sizeof(T);
+			level.push_back(leaf);
+		}
+
+		// Then each interior level, reusing nodes whose children all survived
+		int height = 0;
+		while (level.size() > 1) {
+			height++;
+			std::vector<NodePtr> parents;
+			for (size_t first = 0; first < level.size(); first += branching) {
+				const size_t last = std::min(first + branching, level.size());
+				const NodePtr old = previous.nodeAt(height, first / branching);
+				if (old != nullptr && old->children.size() == last - first &&
+					std::equal(level.begin() + first, level.begin() + last, old->children.begin())) {
+					parents.push_back(old);
+					continue;
+				}
+				std::shared_ptr<Node> parent = std::make_shared<Node>();
+				parent->children.assign(level.begin() + first, level.begin() + last);
+				result.allocatedBytes += sizeof(Node) + parent->children.size() * sizeof(NodePtr);
+				parents.push_back(parent);
+			}
+			level.swap(parents);
+		}
+		result.root = level[0];
+		result.height = height;
+		return result;
+	}
+
+	// Bytes of chunks this version had to allocate instead of sharing
+	size_t bytesAllocated() const {
+		return allocatedBytes;
+	}
+
+private:
+	struct Node {
+		std::vector<std::shared_ptr<const Node>> children;
+		std::vector<T> values;
+	};
+	using NodePtr = std::shared_ptr<const Node>;
+
+	NodePtr root;
+	size_t count;
+	int height; // 0 when the root is a leaf
+	size_t allocatedBytes;
+
+	// Number of leaves below one node of the given level
+	static size_t leavesUnder(int level) {
+		size_t result = 1;
+		for (int i = 0; i < level; i++) {
+			result *= branching;
+		}
+		return result;
+	}
+
+	// Node at a level (0 = leaves) by its position within that level, if any
+	NodePtr nodeAt(int level, size_t index) const {
+		if (root == nullptr || level > height || index >= leavesUnder(height - level)) {
+			return nullptr;
+		}
+		NodePtr node = root;
+		for (int current = height; current > level; current--) {
+			const size_t child = (index / leavesUnder(current - 1 - level)) % branching;
+			if (child >= node->children.size()) {
+				return nullptr;
+			}
+			node = node->children[child];
+		}
+		return node;
+	}
+
+	static NodePtr setIn(const NodePtr& node, int level, size_t index, const T& value, size_t& bytes) {
+		std::shared_ptr<Node> copy = std::make_shared<Node>(*node);
+		if (level == 0) {
+			copy->values[index % leafSize] = value;
+			bytes += sizeof(Node) + copy->values.size() * sizeof(T);
+		}
+		else {
+			const size_t child = (index / leafSize / leavesUnder(level - 1)) % branching;
+			copy->children[child] = setIn(node->children[child], level - 1, index, value, bytes);
+			bytes += sizeof(Node) + copy->children.size() * sizeof(NodePtr);
+		}
+		return copy;
+	}
+
+	static void appendFrom(const Node* node, int level, std::vector<T>& values) {
+		if (node == nullptr) {
+			return;
+		}
+		if (level == 0) {
+			values.insert(values.end(), node->values.begin(), node->values.end());
+			return;
+		}
+		for (const NodePtr& child : node->children) {
+			appendFrom(child.get(), level - 1, values);
+		}
+	}
+};
@@ -0,0 +1,137 @@
+#include "PointGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+PointGrid::PointGrid(float cellSize) : cellSize(cellSize) {
+}
+
+glm::ivec2 PointGrid::cellOf(glm::vec2 position) const {
+	return glm::ivec2((int)std::floor(position.x / cellSize), (int)std::floor(position.y / cellSize));
+}
+
+uint64_t PointGrid::key(glm::ivec2 cell) {
+	return ((uint64_t)(uint32_t)cell.x << 32) | (uint32_t)cell.y;
+}
+
+const std::vector<int>* PointGrid::cellAt(glm::ivec2 cell) const {
+	const auto found = cells.find(key(cell));
+	return found == cells.end() ? nullptr : &found->second;
+}
+
+void PointGrid::build(const std::vector<glm::vec3>& points) {
+	cells.clear();
+	for (int i = 0; i < points.size(); i++) {
+		insert(i, points[i]);
+	}
+}
+
+void PointGrid::insert(int index, glm::vec3 point) {
+	cells[key(cellOf(point))].push_back(index);
+}
+
+// Only touches the grid when the point crosses into another cell
+void PointGrid::move(int index, glm::vec3 from, glm::vec3 to) {
+	const glm::ivec2 oldCell = cellOf(from);
+	const glm::ivec2 newCell = cellOf(to);
+	if (oldCell == newCell) {
+		return;
+	}
+	const auto found = cells.find(key(oldCell));
+	if (found != cells.end()) {
+		std::vector<int>& indices = found->second;
+		const auto position = std::find(indices.begin(), indices.end(), index);
+		if (position != indices.end()) {
+			*position = indices.back();
+			indices.pop_back();
+		}
+		if (indices.empty()) {
+			cells.erase(found);
+		}
+	}
+	insert(index, to);
+}
+
+// Closest point within radius of position, or -1 if there is none
+int PointGrid::nearest(glm::vec3 position, float radius, const std::vector<glm::vec3>& points) const {
+	const glm::ivec2 low = cellOf(glm::vec2(position) - radius);
+	const glm::ivec2 high = cellOf(glm::vec2(position) + radius);
+	int best = -1;
+	float bestDistance = radius;
+	for (int x = low.x; x <= high.x; x++) {
+		for (int y = low.y; y <= high.y; y++) {
+			const std::vector<int>* indices = cellAt(glm::ivec2(x, y));
+			if (indices == nullptr) {
+				continue;
+			}
+			for (int i : *indices) {
+				const float distance = glm::distance(glm::vec2(position), glm::vec2(points[i]));
+				if (distance < bestDistance || (distance == bestDistance && best >= 0 && i < best)) {
+					best = i;
+					bestDistance = distance;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+// Every point inside the axis aligned rectangle spanned by two corners
+void PointGrid::queryRect(glm::vec2 corner, glm::vec2 opposite, const std::vector<glm::vec3>& points, std::vector<int>& result) const {
+	const glm::vec2 low = glm::min(corner, opposite);
+	const glm::vec2 high = glm::max(corner, opposite);
+	const glm::ivec2 lowCell = cellOf(low);
+	const glm::ivec2 highCell = cellOf(high);
+	// A huge rectangle is cheaper to answer by walking the occupied cells
+	const bool walkCells = (double)(highCell.x - lowCell.x + 1) * (highCell.y - lowCell.y + 1) > (double)cells.size();
+	auto collect = [&](const std::vector<int>& indices) {
+		for (int i : indices) {
+			if (points[i].x >= low.x && points[i].x <= high.x && points[i].y >= low.y && points[i].y <= high.y) {
+				result.push_back(i);
+			}
+		}
+	};
+	if (walkCells) {
+		for (const auto& cell : cells) {
+			collect(cell.second);
+		}
+	}
+	else {
+		for (int x = lowCell.x; x <= highCell.x; x++) {
+			for (int y = lowCell.y; y <= highCell.y; y++) {
+				if (const std::vector<int>* indices = cellAt(glm::ivec2(x, y))) {
+					collect(*indices);
+				}
+			}
+		}
+	}
+	std::sort(result.begin(), result.end());
+}
+
+// Every point inside a closed polygon, using the even-odd rule
+void PointGrid::queryLasso(const std::vector<glm::vec2>& polygon, const std::vector<glm::vec3>& points, std::vector<int>& result) const {
+	if (polygon.size() < 3) {
+		return;
+	}
+	glm::vec2 low = polygon[0];
+	glm::vec2 high = polygon[0];
+	for (const glm::vec2& vertex : polygon) {
+		low = glm::min(low, vertex);
+		high = glm::max(high, vertex);
+	}
+	std::vector<int> candidates;
+	queryRect(low, high, points, candidates);
+	for (int i : candidates) {
+		const glm::vec2 p = glm::vec2(points[i]);
+		bool inside = false;
+		for (size_t a = 0, b = polygon.size() - 1; a < polygon.size(); b = a++) {
+			if ((polygon[a].y > p.y) != (polygon[b].y > p.y) &&
+				p.x < (polygon[b].x - polygon[a].x) * (p.y - polygon[a].y) / (polygon[b].y - polygon[a].y) + polygon[a].x) {
+				inside = !inside;
+			}
+		}
+		if (inside) {
+			result.push_back(i);
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform hash grid over the xy positions of a point array, kept in sync
+// incrementally so picking doesn't have to test every point.
+class PointGrid {
+
+public:
+	explicit PointGrid(float cellSize = 0.35f);
+
+	void build(const std::vector<glm::vec3>& points);
+	void insert(int index, glm::vec3 point);
+	void move(int index, glm::vec3 from, glm::vec3 to);
+
+	int nearest(glm::vec3 position, float radius, const std::vector<glm::vec3>& points) const;
+	void queryRect(glm::vec2 corner, glm::vec2 opposite, const std::vector<glm::vec3>& points, std::vector<int>& result) const;
+	void queryLasso(const std::vector<glm::vec2>& polygon, const std::vector<glm::vec3>& points, std::vector<int>& result) const;
+
+private:
+	float cellSize;
+	std::unordered_map<uint64_t, std::vector<int>> cells;
+
+	glm::ivec2 cellOf(glm::vec2 position) const;
+	static uint64_t key(glm::ivec2 cell);
+	const std::vector<int>* cellAt(glm::ivec2 cell) const;
+};
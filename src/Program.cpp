@@ -1,5 +1,7 @@
 #include "Program.h"
 
+float oldOrder = 0;
+
 Program::Program() {
 	window = nullptr;
 	renderEngine = nullptr;
@@ -20,9 +22,7 @@ void Program::start() {
 
 	renderEngine = new RenderEngine(window);
 
-	mousePosition = std::make_shared<glm::vec3>(0);
-
-	InputHandler::setUp(renderEngine, mousePosition);
+	InputHandler::setUp(renderEngine);
 	mainLoop();
 }
 
@@ -63,115 +63,166 @@ void Program::setupWindow() {
 }
 
 void Program::clearKnots() {
-	knotsRender->verts.clear();
-	activeKnot->verts.clear();
-	renderEngine->updateBuffers(*knotsRender);
-	renderEngine->updateBuffers(*activeKnot);
+	knotsRender.verts.clear();
+	activeKnot.verts.clear();
+	renderEngine->updateBuffers(knotsRender);
+	renderEngine->updateBuffers(activeKnot);
 }
 
 void Program::clearCurve() {
-	bsplineCurve->verts.clear();
-	demoPoint->verts.clear();
-	demoLines->verts.clear();
-	renderEngine->updateBuffers(*bsplineCurve);
-	renderEngine->updateBuffers(*demoPoint);
-	renderEngine->updateBuffers(*demoLines);
+	bsplineCurve.verts.clear();
+	curveSpans.clear();
+	spanBvh.clear();
+	curveLayoutDirty = true;
+	renderEngine->updateBuffers(bsplineCurve);
+	curvatureComb.verts.clear();
+	renderEngine->updateBuffers(curvatureComb);
+	arcLengthMarkers.verts.clear();
+	renderEngine->updateBuffers(arcLengthMarkers);
+	cursorProjection.verts.clear();
+	renderEngine->updateBuffers(cursorProjection);
+	intersectionMarkers.verts.clear();
+	renderEngine->updateBuffers(intersectionMarkers);
+}
+
+void Program::clearDemo() {
+	demoPoint.verts.clear();
+	demoLines.verts.clear();
+	renderEngine->updateBuffers(demoPoint);
+	renderEngine->updateBuffers(demoLines);
 }
 
 // Creates an object from specified vertices - no texture. Default object is a 2D triangle.
 void Program::createTestGeometryObject() {
-	std::shared_ptr<Geometry> testObject = std::make_shared<Geometry>();
-
-	testObject->verts.push_back(glm::vec3(-5.f, -3.f, 0.f));
-	testObject->verts.push_back(glm::vec3(5.f, -3.f, 0.f));
-	testObject->verts.push_back(glm::vec3(0.f, 5.f, 0.f));
-	renderEngine->assignBuffers(*testObject);
-	renderEngine->updateBuffers(*testObject);
-	geometryObjects.push_back(testObject);
+	// The registry keeps drawing the buffers after the CPU side copy is gone
+	Geometry testObject;
+
+	testObject.verts.push_back(glm::vec3(-5.f, -3.f, 0.f));
+	testObject.verts.push_back(glm::vec3(5.f, -3.f, 0.f));
+	testObject.verts.push_back(glm::vec3(0.f, 5.f, 0.f));
+	renderEngine->assignBuffers(testObject);
+	renderEngine->updateBuffers(testObject);
 }
 
 void Program::createControlPoints() {
-	controlPoints = std::make_shared<Geometry>();
-	controlPoints->drawMode = GL_POINTS;
-	controlPoints->color = glm::vec4(0.75f, 0.75f, 0.75f, 1.0f);
-	renderEngine->assignBuffers(*controlPoints);
-	geometryObjects.push_back(controlPoints);
-
+	controlPoints.setView(&curve.controlPoints);
+	controlPoints.drawMode = GL_POINTS;
+	controlPoints.color = glm::vec4(0.75f, 0.75f, 0.75f, 1.0f);
+	controlPoints.transform = curveTransform;
+	controlPoints.layer = 1;
+	renderEngine->assignBuffers(controlPoints);
 }
 
 void Program::createActivePoint() {
-	activePoint = std::make_shared<Geometry>();
-	activePoint->drawMode = GL_POINTS;
-	activePoint->color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-	renderEngine->assignBuffers(*activePoint);
-	geometryObjects.push_back(activePoint);
+	activePoint.setView(&curve.controlPoints, 0, 0);
+	activePoint.drawMode = GL_POINTS;
+	activePoint.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	activePoint.transform = curveTransform;
+	renderEngine->assignBuffers(activePoint);
 }
 
 void Program::createBsplineCurve() {
-	bsplineCurve = std::make_shared<Geometry>();
-	renderEngine->assignBuffers(*bsplineCurve);
-	geometryObjects.push_back(bsplineCurve);
+	bsplineCurve.transform = curveTransform;
+	bsplineCurve.layer = 2;
+	renderEngine->assignBuffers(bsplineCurve);
 }
 
 void Program::createDemoLines() {
-	demoLines = std::make_shared<Geometry>();
-	demoLines->drawMode = GL_LINES;
-	demoLines->color = glm::vec4(0.25f, 0.25f, 1.0f, 1.0f);
-	renderEngine->assignBuffers(*demoLines);
-	geometryObjects.push_back(demoLines);
+	demoLines.drawMode = GL_LINES;
+	demoLines.color = glm::vec4(0.25f, 0.25f, 1.0f, 1.0f);
+	demoLines.transform = curveTransform;
+	demoLines.layer = 2;
+	renderEngine->assignBuffers(demoLines);
 }
 
 void Program::createDemoPoint() {
-	demoPoint = std::make_shared<Geometry>();
-	demoPoint->drawMode = GL_POINTS;
-	demoPoint->color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
-	renderEngine->assignBuffers(*demoPoint);
-	geometryObjects.push_back(demoPoint);
+	demoPoint.drawMode = GL_POINTS;
+	demoPoint.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
+	demoPoint.transform = curveTransform;
+	renderEngine->assignBuffers(demoPoint);
+}
+
+void Program::createSelection() {
+	selectedPoints.drawMode = GL_POINTS;
+	selectedPoints.color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
+	selectedPoints.transform = curveTransform;
+	renderEngine->assignBuffers(selectedPoints);
+
+	// The outline follows the cursor, so it is drawn in screen space
+	selectionOutline.drawMode = GL_LINE_LOOP;
+	selectionOutline.color = glm::vec4(0.0f, 1.0f, 1.0f, 1.0f);
+	renderEngine->assignBuffers(selectionOutline);
 }
 
-void Program::savePoints() {
-	// Save the control points
-	controlPointSave.clear();
-	controlPointSave = controlPoints->verts;
-	// Save the active point
-	activePointSave.clear();
-	activePointSave = activePoint->verts;
+void Program::createCurvatureComb() {
+	curvatureComb.drawMode = GL_LINES;
+	curvatureComb.color = glm::vec4(1.0f, 0.4f, 0.8f, 1.0f);
+	curvatureComb.transform = curveTransform;
+	curvatureComb.layer = 2;
+	renderEngine->assignBuffers(curvatureComb);
 }
 
+void Program::createArcLengthMarkers() {
+	arcLengthMarkers.drawMode = GL_POINTS;
+	arcLengthMarkers.color = glm::vec4(1.0f, 0.6f, 0.0f, 1.0f);
+	arcLengthMarkers.transform = curveTransform;
+	renderEngine->assignBuffers(arcLengthMarkers);
+}
 
-void Program::resetPoints() {
-	// Clear points from the screen
-	controlPoints->verts.clear();
-	renderEngine->updateBuffers(*controlPoints);
-	activePoint->verts.clear();
-	renderEngine->updateBuffers(*activePoint);
+void Program::createCursorProjection() {
+	cursorProjection.drawMode = GL_LINES;
+	cursorProjection.color = glm::vec4(0.3f, 1.0f, 0.3f, 1.0f);
+	cursorProjection.transform = curveTransform;
+	renderEngine->assignBuffers(cursorProjection);
 }
 
-void Program::updateControlPoints() {
-	// controlPoints->color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
+void Program::createIntersectionMarkers() {
+	intersectionMarkers.drawMode = GL_POINTS;
+	intersectionMarkers.color = glm::vec4(1.0f, 0.2f, 0.2f, 1.0f);
+	intersectionMarkers.transform = curveTransform;
+	intersectionMarkers.layer = 2;
+	renderEngine->assignBuffers(intersectionMarkers);
+}
 
-	controlPoints->modelMatrix = glm::mat4(1.f);
-	controlPoints->modelMatrix = glm::translate(controlPoints->modelMatrix, glm::vec3(translation[0], translation[1], 0.0f));
-	controlPoints->modelMatrix = glm::scale(controlPoints->modelMatrix, glm::vec3(scale));
-	controlPoints->modelMatrix = glm::rotate(controlPoints->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+void Program::updateControlPoints() {
+	// controlPoints.color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
 
-	renderEngine->updateBuffers(*controlPoints);
+	renderEngine->updateBuffers(controlPoints);
 }
 
 
 void Program::addControlPoint(glm::vec3 oldPoint) {
-	nurbValues.push_back(1);
-	activePointIndex = controlPoints->verts.size();
 	updateKnots = true;
-	controlPoints->verts.emplace_back(oldPoint);
+	// A closed curve takes new points before the copies of its first ones
+	if (knotMode == KnotMode::Closed) {
+		activePointIndex = (int)curve.controlPoints.size() - (curve.order - 1);
+		curve.insertControlPoint(activePointIndex, oldPoint);
+		pointGrid.build(curve.controlPoints);
+		selection.clear();
+		activePoint.setView(&curve.controlPoints, activePointIndex, 1);
+		return;
+	}
+	activePointIndex = curve.controlPoints.size();
+	curve.addControlPoint(oldPoint);
+	pointGrid.insert(activePointIndex, oldPoint);
+	activePoint.setView(&curve.controlPoints, activePointIndex, 1);
+}
+
+// Transformation from curve space to screen space set by the UI
+glm::mat4 Program::modelTransform() const {
+	glm::mat4 transform = glm::mat4(1.f);
+	transform = glm::translate(transform, glm::vec3(translation[0], translation[1], 0.0f));
+	transform = glm::scale(transform, glm::vec3(scale));
+	transform = glm::rotate(transform, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+	return transform;
 }
 
 glm::vec4 Program::fixMousePoisiton() const {
 	int width, height;
 	glfwGetWindowSize(window, &width, &height);
 	glm::vec4 mousePosFix = glm::vec4(
-		((mousePosition->x - (float)width / 2) / ((float)width / 2)) * 10 * (float)width / (float)height,
-		(((float)height / 2 - mousePosition->y) / ((float)height / 2)) * 10,
+		((mousePosition.x - (float)width / 2) / ((float)width / 2)) * 10 * (float)width / (float)height,
+		(((float)height / 2 - mousePosition.y) / ((float)height / 2)) * 10,
 		0.0f, 1.0f
 	);
 	// std::cout << mousePosFix.x << "," << mousePosFix.y << std::endl;
@@ -179,235 +230,1352 @@ glm::vec4 Program::fixMousePoisiton() const {
 
 }
 
+// Mouse position in curve space, through the inverse transform cached for this frame
+glm::vec3 Program::mouseCurvePosition() const {
+	const glm::vec4 tempMousePosFix = inverseModelTransform * fixMousePoisiton();
+	return glm::vec3(tempMousePosFix.x, tempMousePosFix.y, 0);
+}
+
 void Program::addActivePoint() {
+	if (interpolateMode) {
+		interpolationPoints.push_back(mouseCurvePosition());
+		activeInterpolationPoint = (int)interpolationPoints.size() - 1;
+		interpolateThroughPoints();
+		return;
+	}
+	addControlPoint(mouseCurvePosition());
+	historyPending = true;
+}
 
-	// Boolean for catching just a single click
-	mousePosition->z = 0;
+// Picks the control point closest to the cursor within the pick radius
+bool Program::selectControlPoint() {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	const int index = pointGrid.nearest(mouseCurvePosition(), 0.35f, curve.controlPoints);
+	pickTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	if (index < 0) {
+		return false;
+	}
+	activePointIndex = index;
+	activePoint.setView(&curve.controlPoints, activePointIndex, 1);
+	return true;
+}
 
-	// Convert screen res to screen space
-	const glm::vec4 tempMousePosFix = glm::inverse(activePoint->modelMatrix) * fixMousePoisiton();
-	const glm::vec3 mousePosFix = glm::vec3(tempMousePosFix.x, tempMousePosFix.y, 0);
+void Program::moveControlPoint(int index, glm::vec3 position) {
+	if (curve.controlPoints[index] == position) {
+		return;
+	}
+	pointGrid.move(index, curve.controlPoints[index], position);
+	invalidateCurveSpans(index);
+	curve.controlPoints[index] = position;
+	spanBvh.refit(curve, index);
+	// The wrapped copy of a point of a closed curve moves along
+	const int twin = wrappedTwin(index);
+	if (twin >= 0) {
+		moveControlPoint(twin, position);
+	}
+}
 
+// The other copy of a point of a closed curve, -1 for points without one
+int Program::wrappedTwin(int index) const {
+	if (knotMode != KnotMode::Closed) {
+		return -1;
+	}
+	const int wrap = curve.order - 1;
+	const int count = (int)curve.controlPoints.size() - wrap;
+	if (index < wrap) {
+		return index + count;
+	}
+	if (index >= count) {
+		return index - count;
+	}
+	return -1;
+}
 
-	if (activePoint->verts.empty()) {
-		addControlPoint(mousePosFix);
-		activePoint->verts.emplace_back(glm::vec3(mousePosFix.x, mousePosFix.y, 0.f));
+// Dragging a selected point drags the whole selection along with it
+void Program::moveActivePoint() {
+	const glm::vec3 mousePosFix = mouseCurvePosition();
+	if (!std::binary_search(selection.begin(), selection.end(), activePointIndex)) {
+		moveControlPoint(activePointIndex, mousePosFix);
+		return;
 	}
-	else {
-		addControlPoint(mousePosFix);
-		activePoint->verts[0] = (mousePosFix);
+	const glm::vec3 offset = mousePosFix - curve.controlPoints[activePointIndex];
+	for (int i : selection) {
+		// A wrapped copy already moved with its point when both are selected
+		const int twin = wrappedTwin(i);
+		if (twin >= 0 && twin < i && std::binary_search(selection.begin(), selection.end(), twin)) {
+			continue;
+		}
+		moveControlPoint(i, curve.controlPoints[i] + offset);
 	}
 }
 
-bool Program::selectControlPoint() {
-	// Convert screen res to screen space
-	const glm::vec4 tempMousePosFix = glm::inverse(activePoint->modelMatrix) * fixMousePoisiton();
-	const glm::vec3 mousePosFix = glm::vec3(tempMousePosFix.x, tempMousePosFix.y, 0);
-	for (int i = 0; i < controlPoints->verts.size(); i++) {
-		if (glm::distance(mousePosFix, controlPoints->verts[i]) < 0.35f) {
-			activePoint->verts[0] = controlPoints->verts[i];
-			activePointIndex = i;
-			return true;
+// Replaces the selection with every control point inside the box or lasso
+void Program::selectInRegion() {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	selection.clear();
+	if (selectionPath.size() >= 2) {
+		std::vector<glm::vec2> region;
+		if (lassoSelect) {
+			region = selectionPath;
+		}
+		else {
+			const glm::vec2 corner = selectionPath.front();
+			const glm::vec2 opposite = selectionPath.back();
+			region = { corner, glm::vec2(opposite.x, corner.y), opposite, glm::vec2(corner.x, opposite.y) };
+		}
+		for (glm::vec2& vertex : region) {
+			vertex = glm::vec2(inverseModelTransform * glm::vec4(vertex, 0.0f, 1.0f));
+		}
+		// A screen aligned box stays axis aligned in curve space at quarter turns
+		if (!lassoSelect && std::fmod(rotation, 90.0f) == 0.0f) {
+			pointGrid.queryRect(region[0], region[2], curve.controlPoints, selection);
+		}
+		else {
+			pointGrid.queryLasso(region, curve.controlPoints, selection);
 		}
 	}
-	return false;
+	pickTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
 }
 
-void Program::moveActivePoint() const
-{
-	const glm::vec4 tempMousePosFix = glm::inverse(activePoint->modelMatrix) * fixMousePoisiton();
-	const glm::vec3 mousePosFix = glm::vec3(tempMousePosFix.x, tempMousePosFix.y, 0);
-	activePoint->verts[0] = mousePosFix;
-	controlPoints->verts[activePointIndex] = mousePosFix;
-	renderEngine->updateBuffers(*controlPoints);
+void Program::updateSelection() {
+	selectedPoints.verts.clear();
+	for (int i : selection) {
+		selectedPoints.verts.push_back(curve.controlPoints[i]);
+	}
+	selectedPoints.visible = drawPoints;
+	renderEngine->updateBuffers(selectedPoints);
+
+	selectionOutline.verts.clear();
+	if (mouseState == MouseState::Select) {
+		if (lassoSelect) {
+			for (const glm::vec2& vertex : selectionPath) {
+				selectionOutline.verts.push_back(glm::vec3(vertex, 0));
+			}
+		}
+		else if (!selectionPath.empty()) {
+			const glm::vec2 corner = selectionPath.front();
+			const glm::vec2 opposite = selectionPath.back();
+			selectionOutline.verts.push_back(glm::vec3(corner, 0));
+			selectionOutline.verts.push_back(glm::vec3(opposite.x, corner.y, 0));
+			selectionOutline.verts.push_back(glm::vec3(opposite, 0));
+			selectionOutline.verts.push_back(glm::vec3(corner.x, opposite.y, 0));
+		}
+	}
+	renderEngine->updateBuffers(selectionOutline);
 }
 
 void Program::removeActivePoint() {
 
-	if(controlPoints->verts.empty()) {
+	if(curve.controlPoints.empty()) {
 		return; // If array is already empty, return so we don't crash
 	}
+	if (interpolateMode) {
+		if (!interpolationPoints.empty()) {
+			interpolationPoints.erase(interpolationPoints.begin() + std::min(activeInterpolationPoint, (int)interpolationPoints.size() - 1));
+			activeInterpolationPoint = std::max((int)interpolationPoints.size() - 1, 0);
+			interpolateThroughPoints();
+		}
+		return;
+	}
 
 	// Otherwise remove the active point and assign a new active point
-	controlPoints->verts.erase(controlPoints->verts.begin() + activePointIndex);
-	nurbValues.erase(nurbValues.begin() + activeKnotIndex);
-	if(controlPoints->verts.empty()) {
-		activePoint->verts.clear();
+	if (knotMode == KnotMode::Closed) {
+		// Removing a wrapped copy removes its point, the copies are made again
+		const int twin = wrappedTwin(activePointIndex);
+		const int index = twin >= 0 ? std::min(activePointIndex, twin) : activePointIndex;
+		curve.unwrapPoints(curve.order - 1);
+		curve.removeControlPoint(index);
+		if (curve.controlPoints.size() >= curve.order) {
+			curve.wrapPoints(curve.order - 1);
+		}
+		else {
+			knotMode = KnotMode::Uniform;
+		}
+	}
+	else {
+		curve.removeControlPoint(activePointIndex);
+	}
+	// Indices past the removed point shift down, so the grid starts over
+	pointGrid.build(curve.controlPoints);
+	selection.clear();
+	if(curve.controlPoints.empty()) {
 		activePointIndex = 0;
+		activePoint.setView(&curve.controlPoints, 0, 0);
 	}
 	else {
-		activePointIndex = controlPoints->verts.size() - 1;
-		activePoint->verts[0] = controlPoints->verts[activePointIndex];
+		activePointIndex = curve.controlPoints.size() - 1;
+		activePoint.setView(&curve.controlPoints, activePointIndex, 1);
 	}
-	renderEngine->updateBuffers(*controlPoints);
 	updateKnots = true;
+	historyPending = true;
 }
 
 
 void Program::updateActivePoint() {
-	// controlPoints->color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
-
-	activePoint->modelMatrix = glm::mat4(1.f);
-	activePoint->modelMatrix = glm::translate(activePoint->modelMatrix, glm::vec3(translation[0], translation[1], 0.0f));
-	activePoint->modelMatrix = glm::scale(activePoint->modelMatrix, glm::vec3(scale));
-	activePoint->modelMatrix = glm::rotate(activePoint->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+	// controlPoints.color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
 
-	// Select and modify control points
-	if(mousePosition->z == 1) {
-		mousePosition->z = selectControlPoint() ? 11 : 33;
-	}
-	if (mousePosition->z == 11) {
+	// Keep the selected point under the cursor while the button is held
+	if (mouseState == MouseState::DragPoint) {
 		moveActivePoint();
 	}
 
-	// Add new control points
-	if (mousePosition->z == 2) {
-		addActivePoint();
-		mousePosition->z = 0;
-	}
-
 	if (removePoint) {
 		removeActivePoint();
 		removePoint = false;
 	}
 	
-	renderEngine->updateBuffers(*activePoint);
+	renderEngine->updateBuffers(activePoint);
 }
 
-int Program::computeDelta(float &uValue) {
-	for (int i = 0; i < controlPointSave.size()+curveOrder; ++i)	
-	{
-		if(uValue>=1.0f) {
-			uValue = 1.0f-0.00001;
+// Drains every input event queued since the last frame, in arrival order
+void Program::processInput() {
+	InputEvent event;
+	// Every sample of a stroke goes into the fit, coalescing would cut corners
+	while (InputHandler::nextEvent(event, coalesceMotion && mouseState != MouseState::Sketch)) {
+		handleInputEvent(event);
+	}
+}
+
+void Program::handleInputEvent(const InputEvent& event) {
+	// Only events that change what is drawn count towards latency
+	if (event.type == InputEventType::MouseDown || event.type == InputEventType::MouseUp ||
+		(event.type == InputEventType::MouseMove && mouseState != MouseState::Idle)) {
+		latencyTracker.inputApplied(event.time);
+	}
+
+	switch (event.type) {
+	case InputEventType::MouseMove:
+		mousePosition = event.position;
+		if (mouseState == MouseState::DragPoint && drawPoints) {
+			moveActivePoint();
+		}
+		if (mouseState == MouseState::DragKnot && drawKnots && !curve.knots.empty()) {
+			moveKnot();
+		}
+		if (mouseState == MouseState::DragInterpolationPoint) {
+			moveInterpolationPoint();
 		}
-		if(uValue>=knots[i] && uValue<knots[i+1]){
-			// std::cout << uValue << ":" << i << ":" << knots[i] << std::endl;
-			return i;
+		if (mouseState == MouseState::Sketch) {
+			continueStroke();
 		}
+		if (mouseState == MouseState::Select) {
+			const glm::vec2 position = glm::vec2(fixMousePoisiton());
+			if (!lassoSelect) {
+				selectionPath.resize(1);
+				selectionPath.push_back(position);
+			}
+			else if (glm::distance(position, selectionPath.back()) > 0.05f) {
+				selectionPath.push_back(position);
+			}
+		}
+		break;
+	case InputEventType::MouseDown:
+		mousePosition = event.position;
+		// Select and modify control points, fall back to knots
+		if (event.button == GLFW_MOUSE_BUTTON_1 && mouseState != MouseState::Select) {
+			mouseState = MouseState::Idle;
+			// A stroke replaces the curve, nothing is picked while sketching
+			if (sketchMode) {
+				mouseState = MouseState::Sketch;
+				beginStroke();
+			}
+			// Control points only follow from the interpolation points in interpolation mode
+			else if (interpolateMode && drawPoints && selectInterpolationPoint()) {
+				mouseState = MouseState::DragInterpolationPoint;
+			}
+			else if (!interpolateMode && drawPoints && selectControlPoint()) {
+				mouseState = MouseState::DragPoint;
+			}
+			else if (!interpolateMode && drawKnots && !curve.knots.empty() && selectKnot()) {
+				mouseState = MouseState::DragKnot;
+			}
+			else {
+				selectCurve();
+			}
+		}
+		// Add new control points
+		if (event.button == GLFW_MOUSE_BUTTON_2 && drawPoints) {
+			addActivePoint();
+		}
+		// Start a box or lasso selection
+		if (event.button == GLFW_MOUSE_BUTTON_3 && drawPoints && mouseState == MouseState::Idle) {
+			mouseState = MouseState::Select;
+			selectionPath.assign(1, glm::vec2(fixMousePoisiton()));
+		}
+		break;
+	case InputEventType::MouseUp:
+		mousePosition = event.position;
+		if (event.button == GLFW_MOUSE_BUTTON_1) {
+			// A finished drag is one step in the history
+			if (mouseState == MouseState::DragPoint || mouseState == MouseState::DragKnot) {
+				historyPending = true;
+				mouseState = MouseState::Idle;
+			}
+			// The drag kept the old parameters, the final position gets its own
+			if (mouseState == MouseState::DragInterpolationPoint) {
+				mouseState = MouseState::Idle;
+				interpolateThroughPoints();
+			}
+			// The whole stroke is one step in the history
+			if (mouseState == MouseState::Sketch) {
+				mouseState = MouseState::Idle;
+				writeStroke();
+				if (strokeFitter.spanCount() > 0) {
+					historyPending = true;
+				}
+			}
+		}
+		if (event.button == GLFW_MOUSE_BUTTON_3 && mouseState == MouseState::Select) {
+			selectInRegion();
+			selectionPath.clear();
+			mouseState = MouseState::Idle;
+		}
+		break;
+	case InputEventType::Key:
+		if ((event.mods & GLFW_MOD_CONTROL) && event.button == GLFW_KEY_Z) {
+			if (event.mods & GLFW_MOD_SHIFT) {
+				redo();
+			}
+			else {
+				undo();
+			}
+		}
+		if ((event.mods & GLFW_MOD_CONTROL) && event.button == GLFW_KEY_Y) {
+			redo();
+		}
+		break;
+	default:
+		break;
 	}
-	return -1;
 }
 
- glm::vec3 Program::deBoorAlg(int delta, float uValue){
- 	std::vector<glm::vec3> contributorPoints;
- 	// float curveDegree = curveOrder - 1;
- 	contributorPoints.reserve(curveOrder);
- 	for (int i = 0; i < curveOrder; i++)
- 	{
-		contributorPoints.push_back(controlPointSave[delta - i]*nurbValues[delta-i]);
- 	}
+void Program::createStandardKnots(){
+	curve.createStandardKnots();
+	curveLayoutDirty = true;
+}
+
+void Program::createUniformKnots() {
+	curve.createUniformKnots();
+	curveLayoutDirty = true;
+}
 
-	for (int r = curveOrder; r >= 2; r--)
-	{
-		int i = delta;
-		for (int s = 0; s <= r-2; s++)
-		{
-			float omega = (uValue - knots[i]) / (knots[i + r - 1] - knots[i]);
-			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
-			i--;
+// Closing a curve repeats its first points at the end, opening it drops them
+void Program::setKnotMode(KnotMode mode) {
+	if (mouseState != MouseState::Idle || mode == knotMode) {
+		return;
+	}
+	if (mode == KnotMode::Closed && curve.controlPoints.size() < curve.order) {
+		return;
+	}
+	if (knotMode == KnotMode::Closed) {
+		curve.unwrapPoints(curve.order - 1);
+	}
+	if (mode == KnotMode::Closed) {
+		curve.wrapPoints(curve.order - 1);
+	}
+	knotMode = mode;
+	interpolateMode = false;
+	if (curve.controlPoints.size() >= curve.order) {
+		if (mode == KnotMode::Standard) {
+			curve.createStandardKnots();
+		}
+		else {
+			curve.createUniformKnots();
 		}
+		curveReplaced();
+		historyPending = true;
+	}
+	else {
+		updateKnots = true;
 	}
+}
 
- 	return contributorPoints[0];
- }
+// The same samples of the curve with uniform knots through the general
+// path, the fixed order kernel, the basis matrix per sample, and the basis
+// matrix once per span
+void Program::benchmarkUniform() {
+	const UniformBasis* basis = UniformBasis::forOrder(curve.order);
+	const EvaluateKernel kernel = evaluateKernel(curve.order);
+	if (!basis || !kernel || curve.controlPoints.size() < curve.order) {
+		return;
+	}
+	Curve uniform = curve;
+	if (!uniform.hasUniformKnots()) {
+		uniform.createUniformKnots();
+	}
+	const int firstSpan = uniform.order - 1;
+	const int spans = (int)uniform.controlPoints.size() - firstSpan;
+	const int perSpan = std::max(1000000 / spans, 2);
+	const int count = spans * perSpan;
+	const float low = uniform.knots[firstSpan];
+	const float high = uniform.knots[uniform.controlPoints.size()];
+	std::vector<float> parameters(count);
+	std::vector<int> deltas(count);
+	for (int s = 0; s < spans; s++) {
+		for (int i = 0; i < perSpan; i++) {
+			const float u = low + (high - low) * (s + (float)i / perSpan) / spans;
+			parameters[s * perSpan + i] = u;
+			deltas[s * perSpan + i] = uniform.findSpan(u);
+		}
+	}
+	std::vector<glm::vec3> points(count);
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	using Clock = std::chrono::steady_clock;
+	auto milliseconds = [](Clock::time_point start) {
+		return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	};
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < count; i++) {
+		points[i] = uniform.evaluate(deltas[i], parameters[i], &pool);
+	}
+	uniformGeneralTime = milliseconds(start);
+	start = Clock::now();
+	for (int i = 0; i < count; i++) {
+		points[i] = kernel(uniform, deltas[i], parameters[i]);
+	}
+	uniformKernelTime = milliseconds(start);
+	start = Clock::now();
+	for (int i = 0; i < count; i++) {
+		points[i] = basis->evaluate(uniform, deltas[i], parameters[i]);
+	}
+	uniformMatrixTime = milliseconds(start);
+	start = Clock::now();
+	for (int s = 0; s < spans; s++) {
+		basis->evaluateSpan(uniform, firstSpan + s, perSpan - 1, &points[s * perSpan]);
+	}
+	uniformSpanTime = milliseconds(start);
+}
 
-float Program::deBoorAlgWeightsOnly(int delta, float uValue) {
-	std::vector<float> contributorPoints;
-	// float curveDegree = curveOrder - 1;
-	contributorPoints.reserve(curveOrder);
-	for (int i = 0; i < curveOrder; i++)
-	{
-		contributorPoints.push_back(nurbValues[delta - i]);
+void Program::updateBsplineCurve() {
+	// Create b-spline curve
+	// checks and preprocessing
+	bsplineCurve.color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
+	if (curveLayoutDirty) {
+		uniformBasis = uniformFastPath && curve.hasUniformKnots() ? UniformBasis::forOrder(curve.order) : nullptr;
 	}
 
-	for (int r = curveOrder; r >= 2; r--)
-	{
-		int i = delta;
-		for (int s = 0; s <= r - 2; s++)
-		{
-			float omega = (uValue - knots[i]) / (knots[i + r - 1] - knots[i]);
-			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
-			i--;
+	if (tessellationMode == TessellationMode::Flatness) {
+		updateFlatBsplineCurve();
+		return;
+	}
+	if (tessellationMode == TessellationMode::Subdivision && curve.hasUniformKnots()) {
+		updateSubdividedBsplineCurve();
+		return;
+	}
+	if (tessellationMode == TessellationMode::ScreenSpace) {
+		layoutBsplineCurveLod();
+	}
+	else {
+		const int resolution = curveResolution();
+		if (curveLayoutDirty || tessellatedResolution != resolution) {
+			layoutBsplineCurve(resolution);
+		}
+	}
+	cullBsplineCurve();
+	refineBsplineCurve();
+	bridgeCulledSpans();
+
+	// Gather every evaluated sample, spans that are still being refined
+	// contribute their coarse samples past the refined prefix
+	bsplineCurve.verts.clear();
+	bsplineCurve.verts.reserve(curveSamples.size());
+	for (const CurveSpan& span : curveSpans) {
+		if (!span.visible) {
+			continue;
+		}
+		const int last = span.first + span.count - 1;
+		for (int i = span.first; i <= last; i++) {
+			const int local = i - span.first;
+			if (local < span.refinedCount || local % coarseStride == 0 || i == last) {
+				bsplineCurve.verts.push_back(curveSamples[i]);
+			}
 		}
 	}
+	renderEngine->updateBuffers(bsplineCurve);
+}
 
-	return contributorPoints[0];
+// Edits are only undone while no drag is in progress
+void Program::undo() {
+	if (mouseState == MouseState::Idle && history.undo(curve)) {
+		interpolateMode = false;
+		curveReplaced();
+	}
 }
 
-void Program::createStandardKnots(){
-	knots.clear();
-	for (int i = 0; i < curveOrder - 1; ++i) {
-		knots.push_back(0);
+void Program::redo() {
+	if (mouseState == MouseState::Idle && history.redo(curve)) {
+		interpolateMode = false;
+		curveReplaced();
 	}
-	const float knotSpacing = 1.f / float(controlPointSave.size() - curveOrder + 1);
-	for (float i = 0; i <= 1; i += knotSpacing) {
-		knots.push_back(i);
+}
+
+// The curve was replaced wholesale, bring everything derived from it up to date
+void Program::curveReplaced() {
+	// The knots of the new curve decide how later edits make knots
+	if (!curve.knots.empty()) {
+		knotMode = curve.isClosed() ? KnotMode::Closed : curve.hasUniformKnots() ? KnotMode::Uniform : KnotMode::Standard;
 	}
-	for (int i = 0; i < curveOrder - 1; ++i)
-	{
-		knots.push_back(1);
+	oldOrder = curve.order;
+	updateKnots = false;
+	historyPending = false;
+	curveLayoutDirty = true;
+	activePointIndex = std::min(activePointIndex, std::max((int)curve.controlPoints.size() - 1, 0));
+	activePoint.setView(&curve.controlPoints, activePointIndex, curve.controlPoints.empty() ? 0 : 1);
+	pointGrid.build(curve.controlPoints);
+	selection.clear();
+	arcLength.clear();
+}
+
+// Knot insertion keeps the shape, so the edit is only in the representation
+void Program::insertKnotAtDemoPoint() {
+	if (mouseState == MouseState::Idle && curve.insertKnot(demoU)) {
+		interpolateMode = false;
+		curveReplaced();
+		historyPending = true;
 	}
 }
 
-void Program::createUniformKnots() {
-	knots.clear();
-	// for (int i = 0; i < curveOrder - 1; ++i) {
-	// 	knots.push_back(0);
-	// }
-	const float knotSpacing = 1.f / float(controlPointSave.size() + curveOrder - 1);
-	for (float i = 0; i <= 1; i += knotSpacing) {
-		knots.push_back(i);
+// Inserts a knot in the middle of every span in one refinement pass
+void Program::splitEverySpan() {
+	if (mouseState != MouseState::Idle || curve.controlPoints.size() < curve.order || curve.knots.empty()) {
+		return;
+	}
+	std::vector<float> midpoints;
+	for (int delta = curve.order - 1; delta < curve.controlPoints.size(); delta++) {
+		if (curve.knots[delta] < curve.knots[delta + 1]) {
+			midpoints.push_back(0.5f * (curve.knots[delta] + curve.knots[delta + 1]));
+		}
 	}
-	// for (int i = 0; i < curveOrder - 1; ++i)
-	// {
-	// 	knots.push_back(1);
-	// }
+	curve.refineKnots(midpoints);
+	interpolateMode = false;
+	curveReplaced();
+	historyPending = true;
 }
 
-void Program::updateBsplineCurve() {
-	// Create b-spline curve
-	// checks and preprocessing
-	bsplineCurve->color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
-	bsplineCurve->modelMatrix = glm::mat4(1.f);
-	bsplineCurve->modelMatrix = glm::translate(bsplineCurve->modelMatrix, glm::vec3(translation[0], translation[1], 0.0f));
-	bsplineCurve->modelMatrix = glm::scale(bsplineCurve->modelMatrix, glm::vec3(scale));
-	bsplineCurve->modelMatrix = glm::rotate(bsplineCurve->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
-
-	const int uIncTemp = uIncrement;
-	const float uOffset = (1.f / (float)uIncTemp);
-	bsplineCurve->verts.reserve(uIncTemp);
-	// Iterate through u values and generate curve
-	float u = knots[0];
-	for (int i = 0; i <= uIncTemp; i++)
-	{
-		// Get the index of the control point that matters
-		int delta = computeDelta(u);
-		if (delta < 0) { return; }
-		// std::cout << "Delta: " << delta << std::endl;
-		// Calculate the point on the curve
-		bsplineCurve->verts.push_back(deBoorAlg(delta, u)/deBoorAlgWeightsOnly(delta,u));
-		u += uOffset;
+// Replaces the curve by a least squares fit of noisy samples along it. The
+// samples are generated again for each pass, as a scanner would stream them.
+void Program::fitNoisySamples() {
+	if (mouseState != MouseState::Idle || curve.controlPoints.size() < curve.order || curve.knots.empty() || fitSamples < 2) {
+		return;
+	}
+	const Curve source = curve;
+	const float low = source.knots[source.order - 1];
+	const float high = source.knots[source.controlPoints.size()];
+	const int chunkSize = 65536;
+	std::vector<glm::vec3> chunk;
+	std::pmr::unsynchronized_pool_resource pool;
+	auto samples = [&](int begin, int end) {
+		std::mt19937 random(begin);
+		std::normal_distribution<float> noise(0.0f, fitNoise);
+		chunk.clear();
+		for (int k = begin; k < end; k++) {
+			const float u = std::min(low + (high - low) * k / (fitSamples - 1), high - 0.00001f);
+			chunk.push_back(source.evaluate(source.findSpan(u), u, &pool) + glm::vec3(noise(random), noise(random), 0));
+		}
+	};
+
+	// Only the time spent in the fitter counts, not generating the samples
+	using Clock = std::chrono::steady_clock;
+	float milliseconds = 0;
+	auto stream = [&](void (LeastSquaresFitter::*pass)(const glm::vec3*, int)) {
+		for (int begin = 0; begin < fitSamples; begin += chunkSize) {
+			samples(begin, std::min(begin + chunkSize, fitSamples));
+			const Clock::time_point start = Clock::now();
+			(fitter.*pass)(chunk.data(), (int)chunk.size());
+			milliseconds += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+		}
+	};
+	fitter.begin(curve.order, std::max(fitControlPoints, curve.order));
+	stream(&LeastSquaresFitter::measure);
+	stream(&LeastSquaresFitter::accumulate);
+	const Clock::time_point solveStart = Clock::now();
+	if (!fitter.solve(curve)) {
+		return;
+	}
+	fitTime = milliseconds + std::chrono::duration<float, std::milli>(Clock::now() - solveStart).count();
+	stream(&LeastSquaresFitter::checkError);
+	interpolateMode = false;
+	curveReplaced();
+	historyPending = true;
+}
+
+// Drops every knot the curve can do without within the tolerance
+void Program::removeKnots() {
+	if (mouseState != MouseState::Idle || curve.controlPoints.size() <= curve.order || curve.knots.empty()) {
+		return;
+	}
+	knotRemoval = knotRemover.simplify(curve);
+	if (knotRemoval.pointsAfter < knotRemoval.pointsBefore) {
+		interpolateMode = false;
+		curveReplaced();
+		historyPending = true;
+	}
+}
+
+// Copies of the curve with every span split in four and the points moved
+// by less than half the tolerance, which the removal should mostly undo
+void Program::benchmarkKnotRemoval() {
+	std::vector<Curve> copies;
+	if (!benchmarkScene(copies)) {
+		return;
+	}
+	std::mt19937 random(12);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<float> newKnots;
+	for (int delta = curve.order - 1; delta < (int)curve.controlPoints.size(); delta++) {
+		const float low = curve.knots[delta];
+		const float high = curve.knots[delta + 1];
+		for (int k = 1; k < 4 && low < high; k++) {
+			newKnots.push_back(low + (high - low) * k / 4);
+		}
+	}
+	std::vector<Curve*> scene;
+	scenePointsBefore = 0;
+	for (Curve& copy : copies) {
+		copy.refineKnots(newKnots);
+		for (glm::vec3& point : copy.controlPoints) {
+			point += 0.25f * knotRemover.tolerance * glm::vec3(unit(random), unit(random), 0);
+		}
+		scenePointsBefore += (int)copy.controlPoints.size();
+		scene.push_back(&copy);
+	}
+	std::vector<KnotRemovalReport> reports;
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	knotRemover.simplify(scene, reports);
+	knotRemovalTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	scenePointsAfter = 0;
+	sceneRemovalError = 0;
+	for (const KnotRemovalReport& report : reports) {
+		scenePointsAfter += report.pointsAfter;
+		sceneRemovalError = std::max(sceneRemovalError, report.maxError);
+	}
+}
+
+// Raises or lowers the order by one without changing the shape, where the
+// order setting would read the same points as a different curve
+void Program::changeOrder(bool elevate) {
+	if (mouseState != MouseState::Idle || curve.controlPoints.size() < curve.order || curve.knots.empty()) {
+		return;
+	}
+	const bool changed = elevate ? orderChanger.elevate(curve) : orderChanger.reduce(curve);
+	orderChangeFailed = !changed;
+	if (changed) {
+		interpolateMode = false;
+		curveReplaced();
+		historyPending = true;
+	}
+}
+
+// Adds detail around the demo point, one level finer than the curve has
+// there. An edited curve starts a new hierarchy.
+void Program::refineAtDemoPoint() {
+	if (mouseState != MouseState::Idle || curve.controlPoints.size() < curve.order || curve.knots.empty()) {
+		return;
+	}
+	if (!hierarchy.represents(curve)) {
+		hierarchy.reset(curve);
+	}
+	// Enough cells that the finer level gets whole functions
+	if (!hierarchy.refineAround(demoU, curve.order)) {
+		return;
+	}
+	curve = hierarchy.curve();
+	hierarchyMemory = hierarchy.memory();
+	interpolateMode = false;
+	curveReplaced();
+	historyPending = true;
+}
+
+// The curve refined detailLevels deep at three spots, against the same
+// detail from knot insertion into one B-spline and from splitting every span
+void Program::benchmarkHierarchy() {
+	if (curve.controlPoints.size() < curve.order || curve.knots.empty()) {
+		return;
+	}
+	const float low = curve.knots[curve.order - 1];
+	const float high = curve.knots[curve.controlPoints.size()];
+	const float spots[] = { 0.25f, 0.5f, 0.75f };
+	HierarchicalCurve detail;
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	detail.reset(curve);
+	for (int level = 0; level < detailLevels; level++) {
+		for (float spot : spots) {
+			detail.refineAround(low + (high - low) * spot, curve.order);
+		}
+	}
+	// Combining the levels into one B-spline is part of the cost
+	detail.curve();
+	detailTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	detailMemory = detail.memory();
+
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	detailShapeError = 0;
+	for (int delta = curve.order - 1; delta < (int)curve.controlPoints.size(); delta++) {
+		if (curve.knots[delta] == curve.knots[delta + 1]) {
+			continue;
+		}
+		for (int k = 0; k < 32; k++) {
+			const float u = curve.knots[delta] + (curve.knots[delta + 1] - curve.knots[delta]) * k / 32;
+			const glm::vec3 a = curve.evaluate(delta, u, &pool);
+			const glm::vec3 b = detail.evaluate(u, &pool);
+			detailShapeError = std::max(detailShapeError, glm::distance(a, b));
+		}
+	}
+}
+
+// Copies of the curve where every other one is an order higher. Each copy
+// evaluated over its domain with the general path at its own order, against
+// the whole scene brought to the higher order and evaluated with one fixed
+// order kernel.
+void Program::benchmarkFixedOrder() {
+	std::vector<Curve> copies;
+	if (!benchmarkScene(copies) || curve.order + 1 > maxKernelOrder) {
+		return;
+	}
+	std::vector<Curve*> scene;
+	for (size_t i = 0; i < copies.size(); i++) {
+		if (i % 2 == 1) {
+			orderChanger.elevate(copies[i]);
+		}
+		scene.push_back(&copies[i]);
+	}
+	const int samples = 100000;
+	std::vector<glm::vec3> points(samples);
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	for (const Curve* copy : scene) {
+		const float low = copy->knots[copy->order - 1];
+		const float high = copy->knots[copy->controlPoints.size()];
+		for (int i = 0; i < samples; i++) {
+			const float u = low + (high - low) * i / (samples - 1);
+			points[i] = copy->evaluate(copy->findSpan(u), u, &pool);
+		}
+	}
+	genericEvaluateTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	start = Clock::now();
+	unifiedCurves = orderChanger.unify(scene, curve.order + 1);
+	unifyTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	const EvaluateKernel kernel = evaluateKernel(curve.order + 1);
+	start = Clock::now();
+	for (const Curve* copy : scene) {
+		const float low = copy->knots[copy->order - 1];
+		const float high = copy->knots[copy->controlPoints.size()];
+		for (int i = 0; i < samples; i++) {
+			const float u = low + (high - low) * i / (samples - 1);
+			points[i] = kernel(*copy, copy->findSpan(u), u);
+		}
+	}
+	kernelEvaluateTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+void Program::createInterpolationPoints() {
+	interpolationPointsRender.setView(&interpolationPoints);
+	interpolationPointsRender.drawMode = GL_POINTS;
+	interpolationPointsRender.color = glm::vec4(0.2f, 0.6f, 1.0f, 1.0f);
+	interpolationPointsRender.transform = curveTransform;
+	interpolationPointsRender.layer = 2;
+	renderEngine->assignBuffers(interpolationPointsRender);
+}
+
+void Program::updateInterpolationPoints() {
+	interpolationPointsRender.visible = interpolateMode && drawPoints;
+	renderEngine->updateDrawState(interpolationPointsRender);
+	renderEngine->updateBuffers(interpolationPointsRender);
+}
+
+// Solves for a curve through every interpolation point from scratch. With
+// too few points for the order the points themselves are the control points.
+void Program::interpolateThroughPoints() {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	interpolator.parameterization = centripetal ? Parameterization::Centripetal : Parameterization::ChordLength;
+	if (!interpolator.interpolate(interpolationPoints, curve.order, curve)) {
+		curve.controlPoints = interpolationPoints;
+		curve.weights.assign(interpolationPoints.size(), 1.0f);
+		curve.createStandardKnots();
+	}
+	interpolationTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	interpolationGrid.build(interpolationPoints);
+	curveReplaced();
+	historyPending = true;
+}
+
+bool Program::selectInterpolationPoint() {
+	const int index = interpolationGrid.nearest(mouseCurvePosition(), 0.35f, interpolationPoints);
+	if (index < 0) {
+		return false;
+	}
+	activeInterpolationPoint = index;
+	return true;
+}
+
+// Moves the grabbed point through the cached factorization, only the
+// control points it still has a visible effect on are touched
+void Program::moveInterpolationPoint() {
+	const glm::vec3 position = mouseCurvePosition();
+	glm::vec3& point = interpolationPoints[activeInterpolationPoint];
+	if (point == position) {
+		return;
+	}
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	interpolationGrid.move(activeInterpolationPoint, point, position);
+	point = position;
+	int first, last;
+	if (interpolator.pointCount() == (int)curve.controlPoints.size() && interpolator.movePoint(activeInterpolationPoint, position, first, last)) {
+		for (int i = first; i <= last; i++) {
+			moveControlPoint(i, interpolator.controlPoint(i));
+		}
+		dragUpdatedPoints = last - first + 1;
+	}
+	else {
+		moveControlPoint(activeInterpolationPoint, position);
+		dragUpdatedPoints = 1;
+	}
+	dragUpdateTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+// A left button stroke in sketch mode starts a new fit
+void Program::beginStroke() {
+	interpolateMode = false;
+	strokeFitter.begin(curve.order);
+	strokeSampleTime = 0;
+	strokeWorstTime = 0;
+	strokeTotalTime = 0;
+	continueStroke();
+}
+
+// Only the last few spans are refit, the cost of a sample doesn't grow with the stroke
+void Program::continueStroke() {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	strokeFitter.addSample(mouseCurvePosition());
+	const float time = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	strokeWorstTime = std::max(strokeWorstTime, time);
+	strokeTotalTime += time;
+	strokeSampleTime = (float)(strokeTotalTime / std::max(strokeFitter.sampleCount(), 1));
+	strokeChanged = true;
+}
+
+void Program::writeStroke() {
+	strokeChanged = false;
+	if (strokeFitter.write(curve)) {
+		curveReplaced();
+	}
+}
+
+// Number of samples to tessellate the curve with this frame
+int Program::curveResolution() {
+	if (adaptiveResolution) {
+		return resolutionController.sampleBudget(uIncrement);
+	}
+	return uIncrement;
+}
+
+// Parameter value of a sample, matching the uniform stepping used for the curve
+float Program::sampleParameter(int sample) const {
+	// The domain only starts at the first knot when the knots are clamped
+	const float low = curve.knots[curve.order - 1];
+	const float high = curve.knots[curve.controlPoints.size()];
+	float u = low + (high - low) * (float)sample / (float)tessellatedResolution;
+	if (u >= high) {
+		u = high - 0.00001f;
+	}
+	return u;
+}
+
+// Groups the samples by knot span so spans can be refined independently
+void Program::layoutBsplineCurve(int resolution) {
+	curveLayoutDirty = false;
+	tessellatedResolution = resolution;
+	curveSpans.clear();
+	curveSamples.resize(resolution + 1);
+	curveParameters.resize(resolution + 1);
+	spanBvh.build(curve);
+
+	// u only increases, so the span search can continue from the previous sample
+	const int lastKnot = (int)curve.knots.size() - 1;
+	int delta = 0;
+	for (int i = 0; i <= resolution; i++) {
+		const float u = sampleParameter(i);
+		while (delta < lastKnot && !(u >= curve.knots[delta] && u < curve.knots[delta + 1])) {
+			delta++;
+		}
+		if (delta >= lastKnot) {
+			curveSamples.resize(i);
+			curveParameters.resize(i);
+			break;
+		}
+		curveParameters[i] = u;
+		if (curveSpans.empty() || curveSpans.back().delta != delta) {
+			curveSpans.push_back({ delta, i, 0, 0, false, true });
+		}
+		curveSpans.back().count++;
+	}
+}
+
+// Gives every span its own sample count from spanSegments. Spans keep their
+// count until the view asks for more, or for less than half of it, and spans
+// whose sampling didn't change keep their evaluated samples.
+void Program::layoutBsplineCurveLod() {
+	// Samples laid out for uniform stepping sit at different parameters
+	if (curveLayoutDirty || tessellatedResolution != 0) {
+		spanBvh.build(curve);
+		curveSpans.clear();
+		curveLayoutDirty = true;
+	}
+	tessellatedResolution = 0;
+
+	const int lastSpan = (int)curve.controlPoints.size() - 1;
+	lodSpans.clear();
+	bool changed = curveLayoutDirty;
+	int sample = 0;
+	size_t previous = 0;
+	for (int delta = curve.order - 1; delta <= lastSpan; delta++) {
+		const float low = curve.knots[delta];
+		const float high = curve.knots[delta + 1];
+		if (!(low < high)) {
+			continue;
+		}
+		while (previous < curveSpans.size() && curveSpans[previous].delta < delta) {
+			previous++;
+		}
+		const bool matched = previous < curveSpans.size() && curveSpans[previous].delta == delta;
+		// The final span also holds the end point of the curve
+		const int endPoint = delta == lastSpan ? 1 : 0;
+
+		const int wanted = spanSegments(delta);
+		int segments = matched ? curveSpans[previous].count - endPoint : 0;
+		if (wanted > segments || wanted * 2 < segments) {
+			// Leave headroom so a slow zoom doesn't re-layout every frame
+			segments = std::min(wanted + wanted / 4, maxSpanSegments);
+		}
+		const int count = segments + endPoint;
+		CurveSpan span = { delta, sample, count, 0, false, true };
+		if (matched && curveSpans[previous].count == count) {
+			span.refinedCount = curveSpans[previous].refinedCount;
+			span.coarse = curveSpans[previous].coarse;
+		}
+		else {
+			changed = true;
+		}
+		lodSpans.push_back(span);
+		sample += count;
+	}
+	if (!changed && lodSpans.size() == curveSpans.size()) {
+		return;
+	}
+	curveLayoutDirty = false;
+
+	// Copy over the samples of spans that kept their sampling
+	lodSamples.resize(sample);
+	lodParameters.resize(sample);
+	previous = 0;
+	for (CurveSpan& span : lodSpans) {
+		while (previous < curveSpans.size() && curveSpans[previous].delta < span.delta) {
+			previous++;
+		}
+		if ((span.coarse || span.refinedCount > 0) && previous < curveSpans.size() && curveSpans[previous].delta == span.delta) {
+			const CurveSpan& old = curveSpans[previous];
+			std::copy_n(curveSamples.begin() + old.first, span.count, lodSamples.begin() + span.first);
+			std::copy_n(curveParameters.begin() + old.first, span.count, lodParameters.begin() + span.first);
+			continue;
+		}
+		const float low = curve.knots[span.delta];
+		const int segments = span.delta == lastSpan ? span.count - 1 : span.count;
+		const float step = (curve.knots[span.delta + 1] - low) / segments;
+		for (int i = 0; i < span.count; i++) {
+			lodParameters[span.first + i] = std::min(low + i * step, curve.knots[lastSpan + 1] - 0.00001f);
+		}
+	}
+	curveSpans.swap(lodSpans);
+	curveSamples.swap(lodSamples);
+	curveParameters.swap(lodParameters);
+}
+
+// The subdivision produces the vertices itself, so no span samples are kept
+void Program::updateFlatBsplineCurve() {
+	if (curveLayoutDirty) {
+		spanBvh.build(curve);
+		curveSpans.clear();
+		curveLayoutDirty = false;
+		flatTessellationStale = true;
+	}
+	if (!flatTessellationStale) {
+		renderEngine->updateDrawState(bsplineCurve);
+		return;
 	}
-	renderEngine->updateBuffers(*bsplineCurve);
+	adaptiveTessellator.tessellate(curve, bsplineCurve.verts, flatParameters, &frameArena);
+	flatTessellationStale = false;
+	flatUniformVertices = 0;
+	renderEngine->updateBuffers(bsplineCurve);
+}
+
+// The polygon is the curve to within the pixel tolerance, so its points are the vertices
+void Program::updateSubdividedBsplineCurve() {
+	if (curveLayoutDirty) {
+		spanBvh.build(curve);
+		curveSpans.clear();
+		curveLayoutDirty = false;
+	}
+	const glm::mat4 clipToPixels = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.5f * viewportSize, 0.0f)), glm::vec3(0.5f * viewportSize, 1.0f));
+	subdivisionRefiner.refine(curve, clipToPixels * curveToClip);
+	subdivisionRefiner.vertices(curve, bsplineCurve.verts, &frameArena);
+	renderEngine->updateBuffers(bsplineCurve);
+}
+
+// The refinement of the current view against de Boor samples of the same
+// count, both timed and measured against the curve
+void Program::benchmarkSubdivision() {
+	if (curve.controlPoints.size() < curve.order || !curve.hasUniformKnots()) {
+		return;
+	}
+	const int repeats = 20;
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	const glm::mat4 clipToPixels = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.5f * viewportSize, 0.0f)), glm::vec3(0.5f * viewportSize, 1.0f));
+	std::vector<glm::vec3> polygon;
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < repeats; r++) {
+		subdivisionRefiner.refine(curve, clipToPixels * curveToClip);
+		subdivisionRefiner.vertices(curve, polygon, &pool);
+	}
+	subdivisionTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / repeats;
+
+	const int count = (int)polygon.size();
+	const float low = curve.knots[curve.order - 1];
+	const float high = curve.knots[curve.controlPoints.size()];
+	std::vector<glm::vec3> samples(count);
+	start = Clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++) {
+			const float u = std::min(low + (high - low) * i / (count - 1), high - 0.00001f);
+			const int delta = curve.findSpan(u);
+			samples[i] = curve.deBoorAlg(delta, u, &pool) / curve.deBoorAlgWeightsOnly(delta, u, &pool);
+		}
+	}
+	subdivisionDeBoorTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / repeats;
+
+	subdivisionError = SubdivisionRefiner::polylineError(curve, polygon, 32, &pool);
+	subdivisionDeBoorError = SubdivisionRefiner::polylineError(curve, samples, 32, &pool);
+	subdivisionDeBoorVertices = AdaptiveTessellator::uniformSegmentsFor(curve, subdivisionError) + 1;
+}
+
+// Number of segments that keeps the chords of a span within lodPixelError on
+// screen. A segment of parameter length h deviates from the curve by at most
+// h^2 max|C''| / 8, and the second derivative control points bound |C''| on
+// the span. Everything is measured on control points already projected to
+// pixels, which works because the view transform is affine. Weights are left
+// out, so strongly weighted spans only get an estimate.
+int Program::spanSegments(int delta) {
+	const int degree = curve.order - 1;
+	if (degree < 2) {
+		return 1; // straight lines are exact with one segment
+	}
+	std::pmr::vector<glm::vec2> derivative(degree + 1, &frameArena);
+	for (int i = 0; i <= degree; i++) {
+		const glm::vec4 clip = curveToClip * glm::vec4(curve.controlPoints[delta - degree + i], 1.0f);
+		derivative[i] = (glm::vec2(clip) + 1.0f) * 0.5f * viewportSize;
+	}
+	// Differentiate twice in place, P(k)_i = (p-k+1) (P(k-1)_i+1 - P(k-1)_i) / (u_i+p+1 - u_i+k)
+	for (int k = 1; k <= 2; k++) {
+		for (int i = 0; i <= degree - k; i++) {
+			const int global = delta - degree + i;
+			const float span = curve.knots[global + degree + 1] - curve.knots[global + k];
+			derivative[i] = (float)(degree - k + 1) * (derivative[i + 1] - derivative[i]) / span;
+		}
+	}
+	float maxSecond = 0;
+	for (int i = 0; i <= degree - 2; i++) {
+		maxSecond = std::max(maxSecond, glm::length(derivative[i]));
+	}
+	const float length = curve.knots[delta + 1] - curve.knots[delta];
+	const float segments = std::ceil(length * std::sqrt(maxSecond / (8.0f * lodPixelError)));
+	return (int)glm::clamp(segments, 1.0f, (float)maxSpanSegments);
+}
+
+// Marks every span a control point contributes to for re-evaluation
+void Program::invalidateCurveSpans(int pointIndex) {
+	flatTessellationStale = true;
+	arcLength.invalidate(pointIndex);
+	// Spans are laid out in increasing delta
+	auto span = std::lower_bound(curveSpans.begin(), curveSpans.end(), pointIndex, [](const CurveSpan& span, int delta) {
+		return span.delta < delta;
+	});
+	for (; span != curveSpans.end() && span->delta < pointIndex + curve.order; ++span) {
+		span->refinedCount = 0;
+		span->coarse = false;
+	}
+}
+
+// Spans being edited come first, then spans with the largest on-screen extent
+float Program::curveSpanPriority(int span) const {
+	const int delta = curveSpans[span].delta;
+	float length = 0;
+	for (int i = delta - curve.order + 2; i <= delta; i++) {
+		length += glm::distance(curve.controlPoints[i - 1], curve.controlPoints[i]);
+	}
+	length *= scale;
+	if (delta >= activePointIndex && delta < activePointIndex + curve.order) {
+		length += 1e6f;
+	}
+	return length;
+}
+
+void Program::evaluateCurveSample(int sample, int delta) {
+	if (uniformBasis) {
+		curveSamples[sample] = uniformBasis->evaluate(curve, delta, curveParameters[sample]);
+	}
+	else if (const EvaluateKernel kernel = evaluateKernel(curve.order)) {
+		curveSamples[sample] = kernel(curve, delta, curveParameters[sample]);
+	}
+	else {
+		curveSamples[sample] = curve.evaluate(delta, curveParameters[sample], &frameArena);
+	}
+	samplesEvaluated++;
+}
+
+// Consecutive samples of one span, with uniform knots they share one product with the basis matrix
+void Program::evaluateCurveSamples(int first, int count, int delta) {
+	if (uniformBasis) {
+		uniformBasis->evaluateSpan(curve, delta, &curveParameters[first], count, &curveSamples[first]);
+		samplesEvaluated += count;
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		evaluateCurveSample(first + i, delta);
+	}
+}
+
+// Samples [begin, end) of a span, leaving out the ones the coarse pass has
+// already evaluated
+void Program::evaluateFineSamples(int span, int begin, int end) {
+	const CurveSpan& curveSpan = curveSpans[span];
+	const int last = curveSpan.count - 1;
+	for (int i = begin; i < end;) {
+		if (!curveSpan.coarse) {
+			evaluateCurveSamples(curveSpan.first + i, end - i, curveSpan.delta);
+			return;
+		}
+		if (i % coarseStride == 0 || i == last) {
+			i++;
+			continue;
+		}
+		const int run = std::min({ end, (i / coarseStride + 1) * coarseStride, last });
+		evaluateCurveSamples(curveSpan.first + i, run - i, curveSpan.delta);
+		i = run;
+	}
+}
+
+// With progressive refinement evaluates a coarse pass of every stale span
+// right away, then fills in the remaining samples by priority until the
+// per-frame budget runs out
+void Program::refineBsplineCurve() {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	const Clock::duration budget = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<float, std::milli>(refineBudget));
+
+	std::pmr::vector<int> pending(&frameArena);
+	pending.reserve(curveSpans.size());
+	for (int s = 0; s < curveSpans.size(); s++) {
+		CurveSpan& span = curveSpans[s];
+		if (!span.visible) {
+			continue;
+		}
+		if (progressiveRefine && !span.coarse) {
+			for (int i = 0; i < span.count; i += coarseStride) {
+				evaluateCurveSample(span.first + i, span.delta);
+			}
+			evaluateCurveSample(span.first + span.count - 1, span.delta);
+			span.coarse = true;
+		}
+		if (span.refinedCount < span.count) {
+			pending.push_back(s);
+		}
+	}
+
+	if (!progressiveRefine) {
+		for (int s : pending) {
+			completeCurveSpan(s);
+		}
+		pending.clear();
+	}
+	else {
+		std::pmr::vector<float> priority(curveSpans.size(), &frameArena);
+		for (int s : pending) {
+			priority[s] = curveSpanPriority(s);
+		}
+		std::sort(pending.begin(), pending.end(), [&](int a, int b) { return priority[a] > priority[b]; });
+
+		// Check the clock in small batches so one long span can't blow the budget
+		const int batch = 64;
+		bool outOfTime = false;
+		for (int s : pending) {
+			CurveSpan& span = curveSpans[s];
+			while (span.refinedCount < span.count && !outOfTime) {
+				const int end = std::min(span.refinedCount + batch, span.count);
+				evaluateFineSamples(s, span.refinedCount, end);
+				span.refinedCount = end;
+				outOfTime = Clock::now() - start > budget;
+			}
+			if (outOfTime) {
+				break;
+			}
+		}
+	}
+
+	refineBacklog = 0;
+	refineBacklogSpans = 0;
+	for (const CurveSpan& span : curveSpans) {
+		if (span.visible && span.refinedCount < span.count) {
+			refineBacklog += span.count - span.refinedCount;
+			refineBacklogSpans++;
+		}
+	}
+}
+
+// Evaluates every sample of a span that is still missing
+void Program::completeCurveSpan(int span) {
+	CurveSpan& curveSpan = curveSpans[span];
+	evaluateFineSamples(span, curveSpan.refinedCount, curveSpan.count);
+	curveSpan.refinedCount = curveSpan.count;
+	curveSpan.coarse = true;
+}
+
+// Spans whose bounds miss the view keep their samples but are skipped
+void Program::cullBsplineCurve() {
+	culledSpans = 0;
+	if (!cullCurve) {
+		for (CurveSpan& span : curveSpans) {
+			span.visible = true;
+		}
+		return;
+	}
+
+	// The view in curve space, widened to a box when the curve is rotated
+	const glm::mat4 clipToCurve = glm::inverse(curveToClip);
+	SpanBounds view;
+	for (int corner = 0; corner < 4; corner++) {
+		const glm::vec4 clip = glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, 0.0f, 1.0f);
+		view.expand(glm::vec2(clipToCurve * clip));
+	}
+	spanQuery.clear();
+	spanBvh.query(view, spanQuery);
+
+	// Both the query result and the spans are ordered by knot span
+	size_t next = 0;
+	for (CurveSpan& span : curveSpans) {
+		while (next < spanQuery.size() && spanQuery[next] < span.delta) {
+			next++;
+		}
+		span.visible = next < spanQuery.size() && spanQuery[next] == span.delta;
+		if (!span.visible) {
+			culledSpans++;
+		}
+	}
+}
+
+// The curve is drawn as one line strip, so a run of culled spans turns into a
+// straight line between its neighbours. Runs where that line would cross the
+// view are evaluated and drawn after all.
+void Program::bridgeCulledSpans() {
+	for (int s = 0; s < curveSpans.size();) {
+		if (curveSpans[s].visible) {
+			s++;
+			continue;
+		}
+		int end = s;
+		while (end < curveSpans.size() && !curveSpans[end].visible) {
+			end++;
+		}
+		if (s > 0 && end < curveSpans.size()) {
+			const CurveSpan& before = curveSpans[s - 1];
+			const CurveSpan& after = curveSpans[end];
+			if (segmentOnScreen(curveSamples[before.first + before.count - 1], curveSamples[after.first])) {
+				for (int k = s; k < end; k++) {
+					curveSpans[k].visible = true;
+					completeCurveSpan(k);
+					culledSpans--;
+				}
+			}
+		}
+		s = end;
+	}
+}
+
+// Clips a curve space segment against the view (Liang-Barsky)
+bool Program::segmentOnScreen(glm::vec3 start, glm::vec3 end) const {
+	const glm::vec2 origin = glm::vec2(curveToClip * glm::vec4(start, 1.0f));
+	const glm::vec2 direction = glm::vec2(curveToClip * glm::vec4(end, 1.0f)) - origin;
+	const float p[4] = { -direction.x, direction.x, -direction.y, direction.y };
+	const float q[4] = { origin.x + 1, 1 - origin.x, origin.y + 1, 1 - origin.y };
+	float enter = 0;
+	float exit = 1;
+	for (int i = 0; i < 4; i++) {
+		if (p[i] == 0) {
+			if (q[i] < 0) {
+				return false;
+			}
+		}
+		else if (p[i] < 0) {
+			enter = std::max(enter, q[i] / p[i]);
+		}
+		else {
+			exit = std::min(exit, q[i] / p[i]);
+		}
+	}
+	return enter <= exit;
+}
+
+// Moves the demo point to the part of the curve under the cursor
+bool Program::selectCurve() {
+	if (!drawCurve || curveLayoutDirty || spanBvh.spanCount() == 0) {
+		return false;
+	}
+	const float radius = 0.35f / std::abs(scale); // the pick radius is measured on screen
+	const Projection hit = projector.project(curve, spanBvh, glm::vec2(mouseCurvePosition()), radius);
+	if (hit.distance >= radius) {
+		return false;
+	}
+	demoU = std::min(hit.u, curve.knots[curve.controlPoints.size()] - 0.00001f);
+	drawDemoPoint = true;
+	return true;
 }
 
 void Program::deBoorAlgShow(int delta) {
-	std::vector<glm::vec3> contributorPoints;
-	// float curveDegree = curveOrder - 1;
-	contributorPoints.reserve(curveOrder);
-	for (int i = 0; i < curveOrder; i++)
+	std::pmr::vector<glm::vec3> contributorPoints(&frameArena);
+	// float curveDegree = curve.order - 1;
+	contributorPoints.reserve(curve.order);
+	for (int i = 0; i < curve.order; i++)
 	{
-		contributorPoints.push_back(controlPointSave[delta - i]);
+		contributorPoints.push_back(curve.controlPoints[delta - i]);
 	}
 
-	for (int r = curveOrder; r >= 2; r--)
+	for (int r = curve.order; r >= 2; r--)
 	{
 		int i = delta;
 		for (int s = 0; s <= r - 2; s++)
 		{
-			float omega = (demoU - knots[i]) / (knots[i + r - 1] - knots[i]);
-			demoLines->verts.push_back(contributorPoints[s+1]);
-			demoLines->verts.push_back(contributorPoints[s]);
+			float omega = (demoU - curve.knots[i]) / (curve.knots[i + r - 1] - curve.knots[i]);
+			demoLines.verts.push_back(contributorPoints[s+1]);
+			demoLines.verts.push_back(contributorPoints[s]);
 			contributorPoints[s] = (omega * contributorPoints[s]) + ((1 - omega)*contributorPoints[s + 1]);
 			i--;
 		}
@@ -418,62 +1586,207 @@ void Program::deBoorAlgShow(int delta) {
 
 void Program::updateDemoLines() {
 	// create lines to show bspline curve generation graphically/visibly
-	demoLines->modelMatrix = glm::mat4(1.f);
-	demoLines->modelMatrix = glm::translate(demoLines->modelMatrix, glm::vec3(translation[0], translation[1], 0.0f));
-	demoLines->modelMatrix = glm::scale(demoLines->modelMatrix, glm::vec3(scale));
-	demoLines->modelMatrix = glm::rotate(demoLines->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
-
 	// Get the index of the control point that matters
-	int delta = computeDelta(demoU);
+	int delta = curve.computeDelta(demoU);
 	if (delta < 0) { return; }
 	deBoorAlgShow(delta);
 
-	renderEngine->updateBuffers(*demoLines);
+	renderEngine->updateBuffers(demoLines);
+}
+
+// Teeth of length combScale * curvature along the normal, joined at their tips
+void Program::updateCurvatureComb() {
+	curvatureComb.verts.clear();
+	if (drawCurvatureComb && combTeeth > 0) {
+		const float start = curve.knots[curve.order - 1];
+		const float end = curve.knots[curve.controlPoints.size()];
+		combParameters.resize(combTeeth + 1);
+		for (int i = 0; i <= combTeeth; i++) {
+			combParameters[i] = start + (end - start) * i / combTeeth;
+		}
+		curve.evaluateDerivatives(combParameters.data(), combTeeth + 1, 2, combDerivatives, &frameArena);
+
+		glm::vec3 previousTip;
+		for (int i = 0; i <= combTeeth; i++) {
+			const glm::vec3 point = combDerivatives.at(0, i);
+			const glm::vec2 tangent = glm::vec2(combDerivatives.at(1, i));
+			const float speed = glm::length(tangent);
+			const glm::vec2 normal = speed > 0.0f ? glm::vec2(-tangent.y, tangent.x) / speed : glm::vec2(0.0f);
+			const glm::vec3 tip = point - glm::vec3(combScale * combDerivatives.curvature[i] * normal, 0.0f);
+			curvatureComb.verts.push_back(point);
+			curvatureComb.verts.push_back(tip);
+			if (i > 0) {
+				curvatureComb.verts.push_back(previousTip);
+				curvatureComb.verts.push_back(tip);
+			}
+			previousTip = tip;
+		}
+	}
+	renderEngine->updateBuffers(curvatureComb);
+}
+
+void Program::updateArcLengthMarkers() {
+	arcLengthMarkers.verts.clear();
+	if (drawArcLengthMarkers && arcLengthMarkerCount > 0) {
+		arcLength.update(curve);
+		markerLengths.resize(arcLengthMarkerCount + 1);
+		markerParameters.resize(arcLengthMarkerCount + 1);
+		for (int i = 0; i <= arcLengthMarkerCount; i++) {
+			markerLengths[i] = arcLength.totalLength() * i / arcLengthMarkerCount;
+		}
+		arcLength.parametersAt(curve, markerLengths.data(), markerParameters.data(), arcLengthMarkerCount + 1);
+		for (float u : markerParameters) {
+			arcLengthMarkers.verts.push_back(curve.evaluate(curve.findSpan(u), u, &frameArena));
+		}
+	}
+	renderEngine->updateBuffers(arcLengthMarkers);
+}
+
+// Times a million s to u lookups spread evenly over the curve
+void Program::benchmarkArcLength() {
+	if (curve.controlPoints.size() < curve.order || curve.knots.empty()) {
+		return;
+	}
+	arcLength.update(curve);
+	const int count = 1000000;
+	std::vector<float> lengths(count);
+	std::vector<float> parameters(count);
+	for (int i = 0; i < count; i++) {
+		lengths[i] = arcLength.totalLength() * i / (count - 1);
+	}
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	arcLength.parametersAt(curve, lengths.data(), parameters.data(), count);
+	const float milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	arcLengthLookupRate = count / std::max(milliseconds, 0.001f) / 1000.0f;
+}
+
+// Line from the cursor to the closest point of the curve
+void Program::updateCursorProjection() {
+	cursorProjection.verts.clear();
+	if (projectCursor && !curveLayoutDirty) {
+		const glm::vec3 cursor = mouseCurvePosition();
+		const Projection hit = projector.project(curve, spanBvh, glm::vec2(cursor));
+		if (hit.distance < 1e30f) {
+			cursorProjection.verts.push_back(cursor);
+			cursorProjection.verts.push_back(hit.point);
+		}
+	}
+	renderEngine->updateBuffers(cursorProjection);
+}
+
+// Times a million projections of random points around the curve
+void Program::benchmarkProjection() {
+	if (curveLayoutDirty || spanBvh.spanCount() == 0) {
+		return;
+	}
+	const SpanBounds& bounds = spanBvh.bounds();
+	const glm::vec2 margin = 0.25f * (bounds.max - bounds.min);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> x(bounds.min.x - margin.x, bounds.max.x + margin.x);
+	std::uniform_real_distribution<float> y(bounds.min.y - margin.y, bounds.max.y + margin.y);
+	const int count = 1000000;
+	std::vector<glm::vec2> points(count);
+	for (glm::vec2& point : points) {
+		point = glm::vec2(x(random), y(random));
+	}
+	std::vector<Projection> results(count);
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	projector.projectBatch(curve, spanBvh, points.data(), count, results.data());
+	const float milliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	projectionRate = count / std::max(milliseconds, 0.001f) / 1000.0f;
+}
+
+void Program::updateIntersectionMarkers() {
+	intersectionMarkers.verts.clear();
+	if (drawSelfIntersections) {
+		intersector.selfIntersect(curve, intersections);
+		for (const CurveIntersection& intersection : intersections) {
+			intersectionMarkers.verts.push_back(intersection.point);
+		}
+	}
+	renderEngine->updateBuffers(intersectionMarkers);
+}
+
+// Randomly rotated and shifted copies of the curve over its own bounds
+bool Program::benchmarkScene(std::vector<Curve>& copies) {
+	if (curveLayoutDirty || spanBvh.spanCount() == 0) {
+		return false;
+	}
+	const SpanBounds& bounds = spanBvh.bounds();
+	const glm::vec3 centre = glm::vec3(0.5f * (bounds.min + bounds.max), 0);
+	const glm::vec2 size = bounds.max - bounds.min;
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	copies.assign(benchmarkCopies, curve);
+	for (Curve& copy : copies) {
+		const float angle = 3.14159265f * unit(random);
+		const glm::vec3 offset = glm::vec3(0.5f * size.x * unit(random), 0.5f * size.y * unit(random), 0);
+		const glm::mat2 rotation(std::cos(angle), std::sin(angle), -std::sin(angle), std::cos(angle));
+		for (glm::vec3& point : copy.controlPoints) {
+			point = glm::vec3(rotation * glm::vec2(point - centre), 0) + centre + offset;
+		}
+	}
+	return true;
+}
+
+// Intersects copies of the curve turned and shifted at random around its
+// centre, every copy against every other and against itself
+void Program::benchmarkIntersections() {
+	std::vector<Curve> copies;
+	if (!benchmarkScene(copies)) {
+		return;
+	}
+	std::vector<const Curve*> scene;
+	for (const Curve& copy : copies) {
+		scene.push_back(&copy);
+	}
+	std::vector<CurveIntersection> found;
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	intersector.intersect(scene, true, found);
+	intersectionTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	benchmarkIntersectionCount = (int)found.size();
+	const long long spans = (long long)benchmarkCopies * spanBvh.spanCount();
+	bruteForceSpanPairs = spans * (spans + 1) / 2;
 }
 
 void Program::updateDemoPoint() {
 	// draw the current u value as specified in the ui
-	demoPoint->verts.clear();
-	demoPoint->modelMatrix = glm::mat4(1.f);
-	demoPoint->modelMatrix = glm::translate(demoPoint->modelMatrix, glm::vec3(translation[0], translation[1], 0.0f));
-	demoPoint->modelMatrix = glm::scale(demoPoint->modelMatrix, glm::vec3(scale));
-	demoPoint->modelMatrix = glm::rotate(demoPoint->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
-
+	demoPoint.verts.clear();
 	// Iterate through u values and generate curve
 	// Get the index of the control point that matters
-	int delta = computeDelta(demoU);
+	int delta = curve.computeDelta(demoU);
 	if (delta < 0) { return; }
 	// std::cout << "Delta: " << delta << std::endl;
 	// Calculate the point on the curve
-	demoPoint->verts.push_back(deBoorAlg(delta, demoU)/ deBoorAlgWeightsOnly(delta,demoU));
-	renderEngine->updateBuffers(*demoPoint);
+	demoPoint.verts.push_back(curve.evaluate(delta, demoU, &frameArena));
+	renderEngine->updateBuffers(demoPoint);
 }
 
 void Program::createKnots() {
-	activeKnot = std::make_shared<Geometry>();
-	activeKnot->drawMode = GL_POINTS;
-	activeKnot->color = glm::vec4(1.0f, 0.25f, 1.0f, 1.0f);
-	renderEngine->assignBuffers(*activeKnot);
-	geometryObjects.push_back(activeKnot);
-
-	knotsRender = std::make_shared<Geometry>();
-	knotsRender->drawMode = GL_POINTS;
-	knotsRender->color = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
-	renderEngine->assignBuffers(*knotsRender);
-	geometryObjects.push_back(knotsRender);
+	activeKnot.drawMode = GL_POINTS;
+	activeKnot.color = glm::vec4(1.0f, 0.25f, 1.0f, 1.0f);
+	renderEngine->assignBuffers(activeKnot);
+
+	knotsRender.drawMode = GL_POINTS;
+	knotsRender.color = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
+	knotsRender.layer = 1;
+	renderEngine->assignBuffers(knotsRender);
 }
 
 bool Program::selectKnot() {
 	// Convert screen res to screen space
 	const glm::vec4 tempMousePosFix = fixMousePoisiton();
 	const glm::vec3 mousePosFix = glm::vec3(tempMousePosFix.x, tempMousePosFix.y, 0);
-	for (int i = curveOrder; i < knotsRender->verts.size()-curveOrder; i++) {
-		if (glm::distance(mousePosFix, knotsRender->verts[i]) < 0.35f) {
-			if(activeKnot->verts.empty())
+	for (int i = curve.order; i < knotsRender.verts.size()-curve.order; i++) {
+		if (glm::distance(mousePosFix, knotsRender.verts[i]) < 0.35f) {
+			if(activeKnot.verts.empty())
 			{
-				activeKnot->verts.push_back(knotsRender->verts[i]);
+				activeKnot.verts.push_back(knotsRender.verts[i]);
 			} else {
-				activeKnot->verts[0] = knotsRender->verts[i];
+				activeKnot.verts[0] = knotsRender.verts[i];
 			}
 			activeKnotIndex = i;
 			return true;
@@ -486,44 +1799,47 @@ void Program::moveKnot() {
 	const glm::vec4 tempMousePosFix = fixMousePoisiton();
 	const glm::vec3 mousePosFix = glm::vec3(tempMousePosFix.x, -9, 0);
 	float normMousePos = (mousePosFix.x + 12) / 24;
-	if (knots[activeKnotIndex - 1] > normMousePos)
+	if (curve.knots[activeKnotIndex - 1] > normMousePos)
 	{
-		normMousePos = knots[activeKnotIndex - 1]+0.0001;
+		normMousePos = curve.knots[activeKnotIndex - 1]+0.0001;
 	}
-	if (knots[activeKnotIndex + 1] < normMousePos)
+	if (curve.knots[activeKnotIndex + 1] < normMousePos)
 	{
-		normMousePos = knots[activeKnotIndex + 1]-0.0001;
+		normMousePos = curve.knots[activeKnotIndex + 1]-0.0001;
 	}
-	// activeKnot->verts[0] = mousePosFix;
-	if (activeKnot->verts.empty())
+	// activeKnot.verts[0] = mousePosFix;
+	if (activeKnot.verts.empty())
 	{
-		activeKnot->verts.emplace_back(normMousePos * 24 - 12 ,-9, 0);
+		activeKnot.verts.emplace_back(normMousePos * 24 - 12 ,-9, 0);
 	}
 	else {
-		activeKnot->verts[0] = glm::vec3(normMousePos * 24 - 12, -9, 0);
+		activeKnot.verts[0] = glm::vec3(normMousePos * 24 - 12, -9, 0);
+	}
+	knotsRender.verts[activeKnotIndex] = glm::vec3(normMousePos * 24 - 12, -9, 0);
+	if (curve.knots[activeKnotIndex] != normMousePos) {
+		curveLayoutDirty = true;
 	}
-	knotsRender->verts[activeKnotIndex] = glm::vec3(normMousePos * 24 - 12, -9, 0);
-	knots[activeKnotIndex] = normMousePos;
-	renderEngine->updateBuffers(*knotsRender);
+	curve.knots[activeKnotIndex] = normMousePos;
+	renderEngine->updateBuffers(knotsRender);
 }
 
-void Program::updateActiveKnot() {
-	knotsRender->verts.clear();
-	activeKnot->verts.clear();
-	knotsRender->verts.reserve(knots.size());
-	for (int i = 0; i < knots.size(); i++)
+// Lay the knots out along the bottom of the screen
+void Program::placeKnots() {
+	knotsRender.verts.clear();
+	knotsRender.verts.reserve(curve.knots.size());
+	for (int i = 0; i < curve.knots.size(); i++)
 	{
-		knotsRender->verts.emplace_back(knots[i]*24-12, -9, 0);
-	}
-	// Select and modify control points
-	if (mousePosition->z == 33 || mousePosition->z == 1) {
-		mousePosition->z = selectKnot() ? 22 : 0;
+		knotsRender.verts.emplace_back(curve.knots[i]*24-12, -9, 0);
 	}
-	if (mousePosition->z == 22) {
+}
+
+void Program::updateActiveKnot() {
+	// Keep the selected knot under the cursor while the button is held
+	if (mouseState == MouseState::DragKnot) {
 		moveKnot();
 	}
-	renderEngine->updateBuffers(*knotsRender);
-	renderEngine->updateBuffers(*activeKnot);
+	renderEngine->updateBuffers(knotsRender);
+	renderEngine->updateBuffers(activeKnot);
 }
 
 
@@ -549,16 +1865,78 @@ void Program::drawUI() {
 		ImGui::DragFloat2("Translation", (float*)&translation, 0.01f);
 
 		ImGui::Text("Curve parameters:");
-		ImGui::DragInt("Order", (int*)&curveOrder, 1, 2, controlPointSave.size());
+		ImGui::DragInt("Order", (int*)&curve.order, 1, 2, curve.controlPoints.size());
+		if (ImGui::IsItemDeactivatedAfterEdit()) {
+			historyPending = true;
+		}
 		ImGui::DragInt("Resolution", (int*)&uIncrement, 1, 1, 10000);
-		ImGui::DragFloat("Demo point", (float*)&demoU, 0.001, 0,1);
+		ImGui::Checkbox("Progressive refinement", (bool*)&progressiveRefine);
+		if (progressiveRefine) {
+			ImGui::DragFloat("Refine budget (ms)", (float*)&refineBudget, 0.05f, 0.1f, 16.0f);
+			ImGui::Text("Refinement backlog: %d samples in %d spans", refineBacklog, refineBacklogSpans);
+		}
+		ImGui::Checkbox("Adaptive resolution", (bool*)&adaptiveResolution);
+		if (adaptiveResolution) {
+			ImGui::DragFloat("Target frame time (ms)", (float*)&resolutionController.targetFrameTime, 0.05f, 1.0f, 33.3f);
+			ImGui::Text("Effective resolution: %d", resolutionController.effectiveResolution);
+			ImGui::Text("Evaluation %.2f ms, render %.2f ms", resolutionController.evalTime, resolutionController.renderTime);
+		}
+		const char* tessellationModes[] = { "Uniform", "Screen space LOD", "Flatness adaptive", "Lane-Riesenfeld subdivision" };
+		if (ImGui::Combo("Tessellation", (int*)&tessellationMode, tessellationModes, 4)) {
+			curveLayoutDirty = true;
+		}
+		if (tessellationMode == TessellationMode::ScreenSpace) {
+			ImGui::DragFloat("Pixel error", (float*)&lodPixelError, 0.01f, 0.05f, 10.0f);
+		}
+		if (tessellationMode == TessellationMode::Flatness) {
+			if (ImGui::DragFloat("Flatness tolerance", (float*)&adaptiveTessellator.tolerance, 0.0005f, 0.0001f, 1.0f, "%.4f")) {
+				flatTessellationStale = true;
+			}
+			// Measuring the uniform equivalent takes a while, so only on request
+			if (ImGui::Button("Compare with uniform") && !flatParameters.empty()) {
+				flatMaxError = AdaptiveTessellator::chordError(curve, flatParameters);
+				flatUniformVertices = AdaptiveTessellator::uniformSegmentsFor(curve, flatMaxError) + 1;
+			}
+			if (flatUniformVertices > 0) {
+				ImGui::SameLine();
+				ImGui::Text("max error %.5f, uniform needs %s%d vertices, %.1f%% saved", flatMaxError,
+					flatUniformVertices > AdaptiveTessellator::uniformLimit ? "over " : "", flatUniformVertices,
+					100.0f * (1.0f - (float)bsplineCurve.verts.size() / (float)flatUniformVertices));
+			}
+		}
+		if (tessellationMode == TessellationMode::Subdivision) {
+			if (!curve.hasUniformKnots()) {
+				ImGui::Text("Subdivision needs uniform knots, sampling instead");
+			}
+			ImGui::DragFloat("Polygon pixel error", (float*)&subdivisionRefiner.pixelTolerance, 0.01f, 0.05f, 10.0f);
+			ImGui::SliderInt("Max rounds", (int*)&subdivisionRefiner.maxRounds, 0, 12);
+			ImGui::Text("%d rounds, %d points, within %.2f pixels", subdivisionRefiner.rounds, subdivisionRefiner.pointCount(), subdivisionRefiner.polygonError);
+			if (ImGui::Button("Compare with de Boor sampling")) {
+				benchmarkSubdivision();
+			}
+			if (subdivisionTime > 0) {
+				ImGui::Text("Subdivision %.3f ms, error %.5f; de Boor %.3f ms, error %.5f; de Boor needs %s%d samples for the same error",
+					subdivisionTime, subdivisionError, subdivisionDeBoorTime, subdivisionDeBoorError,
+					subdivisionDeBoorVertices > AdaptiveTessellator::uniformLimit ? "over " : "", subdivisionDeBoorVertices);
+			}
+		}
+		ImGui::Text("%d curve vertices, uniform sampling would use %d", (int)bsplineCurve.verts.size(), uIncrement + 1);
+		ImGui::Checkbox("Cull off-screen spans", (bool*)&cullCurve);
+		ImGui::SameLine();
+		ImGui::Text("%d of %d spans culled", culledSpans, (int)curveSpans.size());
+		if (curve.controlPoints.size() >= curve.order && curve.knots.size() == curve.controlPoints.size() + curve.order) {
+			// The slider covers the domain, which only is [0, 1] for standard knots
+			const float low = curve.knots[curve.order - 1];
+			const float high = curve.knots[curve.controlPoints.size()];
+			ImGui::DragFloat("Demo point", (float*)&demoU, 0.001f * (high - low), low, high);
+		}
 		
 		if(ImGui::Button("Remove point")&&drawPoints) {
 			removePoint = true;
 			// Fix the curve order to match how many control points are left
-			if(curveOrder > controlPointSave.size()-1 && curveOrder>2)
+			if(curve.order > curve.controlPoints.size()-1 && curve.order>2)
 			{
-				curveOrder = controlPointSave.size()-1;
+				curve.order = curve.controlPoints.size()-1;
 			}
 		}
 
@@ -576,29 +1954,272 @@ void Program::drawUI() {
 		ImGui::SameLine();
 		ImGui::Checkbox("Point", (bool*)&drawDemoPoint);
 
+		ImGui::Checkbox("Curvature comb", (bool*)&drawCurvatureComb);
+		if (drawCurvatureComb) {
+			ImGui::SameLine();
+			ImGui::PushItemWidth(150);
+			ImGui::DragFloat("Comb scale", (float*)&combScale, 0.05f, 0.0f, 100.0f);
+			ImGui::SameLine();
+			ImGui::DragInt("Teeth", (int*)&combTeeth, 1, 1, 5000);
+			ImGui::PopItemWidth();
+		}
+
+		ImGui::Checkbox("Arc length markers", (bool*)&drawArcLengthMarkers);
+		if (drawArcLengthMarkers) {
+			ImGui::SameLine();
+			ImGui::PushItemWidth(150);
+			ImGui::DragInt("Markers", (int*)&arcLengthMarkerCount, 1, 1, 1000);
+			ImGui::PopItemWidth();
+			ImGui::Text("Length %.3f, %d spans measured in the last refresh", arcLength.totalLength(), arcLength.spansRecomputed);
+		}
+		if (ImGui::Button("Benchmark arc length lookups")) {
+			benchmarkArcLength();
+		}
+		if (arcLengthLookupRate > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%.2f million lookups/s on %d threads", arcLengthLookupRate, parallelThreads());
+		}
+
+		ImGui::Checkbox("Self intersections", (bool*)&drawSelfIntersections);
+		if (drawSelfIntersections) {
+			ImGui::SameLine();
+			ImGui::Text("%d found", (int)intersections.size());
+		}
+		ImGui::PushItemWidth(150);
+		ImGui::DragInt("Copies", (int*)&benchmarkCopies, 1, 2, 1000);
+		ImGui::PopItemWidth();
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark intersections")) {
+			benchmarkIntersections();
+		}
+		if (bruteForceSpanPairs > 0) {
+			ImGui::Text("%d intersections in %.1f ms, %d curve pairs and %d span pairs tested of %lld",
+				benchmarkIntersectionCount, intersectionTime, intersector.curvePairsTested, intersector.spanPairsTested, bruteForceSpanPairs);
+		}
+
+		ImGui::Checkbox("Project cursor onto curve", (bool*)&projectCursor);
+		if (ImGui::Button("Benchmark projection")) {
+			benchmarkProjection();
+		}
+		if (projectionRate > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%.2f million projections/s on %d threads", projectionRate, parallelThreads());
+		}
+
+		ImGui::Checkbox("Lasso selection", (bool*)&lassoSelect);
+		ImGui::SameLine();
+		if (ImGui::Button("Clear selection")) {
+			selection.clear();
+		}
+		ImGui::SameLine();
+		ImGui::Text("%d points selected, last pick %.3f ms", (int)selection.size(), pickTime);
+
 		ImGui::Text("Bonus options:");
-		if (ImGui::Button("Use standard knots")) {
-			standardKnots = true;
+		int mode = (int)knotMode;
+		ImGui::RadioButton("Standard knots", &mode, (int)KnotMode::Standard);
+		ImGui::SameLine();
+		ImGui::RadioButton("Uniform knots", &mode, (int)KnotMode::Uniform);
+		ImGui::SameLine();
+		ImGui::RadioButton("Closed", &mode, (int)KnotMode::Closed);
+		if (mode != (int)knotMode) {
+			setKnotMode((KnotMode)mode);
+		}
+		if (ImGui::Button("Reset knots")) {
 			updateKnots = true;
-			uniformKnots = false;
+			historyPending = true;
 		}
 
 		ImGui::SameLine();
 		ImGui::Checkbox("Draw knots", (bool*)&drawKnots);
+		if (ImGui::Checkbox("Uniform basis matrix", (bool*)&uniformFastPath)) {
+			curveLayoutDirty = true;
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark uniform evaluation")) {
+			benchmarkUniform();
+		}
+		if (uniformGeneralTime > 0) {
+			ImGui::Text("General %.1f ms, fixed order %.1f ms, matrix per sample %.1f ms, matrix per span %.1f ms",
+				uniformGeneralTime, uniformKernelTime, uniformMatrixTime, uniformSpanTime);
+		}
 
-		// ImGui::SameLine();
-		// if (ImGui::Button("Use uniform knots")) {
-		// 	uniformKnots = true;
-		// 	updateKnots = true;
-		// 	standardKnots = false;
-		// }
-		ImGui::DragFloat("NURB Value", (float*)&nurbValues[activePointIndex], 0.001, 0);
+		ImGui::Text("Input latency:");
+		if (ImGui::Checkbox("V-sync", (bool*)&vsync)) {
+			glfwSwapInterval(vsync ? 1 : 0);
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Wait for GPU", (bool*)&finishAfterSwap);
+		ImGui::SameLine();
+		ImGui::Checkbox("Histogram", (bool*)&showLatencyHistogram);
+		ImGui::Text("p50 %.1f ms  p90 %.1f ms  p99 %.1f ms  (%d samples)",
+			latencyTracker.percentile(0.5f), latencyTracker.percentile(0.9f), latencyTracker.percentile(0.99f), latencyTracker.sampleCount());
+		ImGui::Text("Poll %.1f, input %.1f, tessellate %.1f, submit %.1f, present %.1f ms",
+			latencyTracker.stageTime(LatencyTracker::Polled), latencyTracker.stageTime(LatencyTracker::InputApplied),
+			latencyTracker.stageTime(LatencyTracker::Tessellated), latencyTracker.stageTime(LatencyTracker::Submitted),
+			latencyTracker.stageTime(LatencyTracker::Presented));
+		if (showLatencyHistogram) {
+			const float maxLatency = 100.0f;
+			latencyTracker.histogram(latencyHistogram, maxLatency);
+			ImGui::PlotHistogram("0-100 ms", latencyHistogram.data(), latencyHistogram.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+		}
+		ImGui::Checkbox("Coalesce mouse motion", (bool*)&coalesceMotion);
+
+		ImGui::Text("Frame scratch %.1f KB of %.1f KB, heap allocations last frame: %d",
+			frameArena.lastFrameBytes / 1024.0f, frameArena.capacity() / 1024.0f, heapAllocationsLastFrame);
+		if (InputHandler::droppedEvents > 0) {
+			ImGui::SameLine();
+			ImGui::Text("(%d events dropped)", InputHandler::droppedEvents);
+		}
+
+		if (!curve.weights.empty() && ImGui::DragFloat("NURB Value", (float*)&curve.weights[activePointIndex], 0.001, 0)) {
+			invalidateCurveSpans(activePointIndex);
+			const int twin = wrappedTwin(activePointIndex);
+			if (twin >= 0) {
+				curve.weights[twin] = curve.weights[activePointIndex];
+				invalidateCurveSpans(twin);
+			}
+		}
+		if (ImGui::IsItemDeactivatedAfterEdit()) {
+			historyPending = true;
+		}
+
+		ImGui::Text("Interpolation:");
+		if (ImGui::Checkbox("Curve through points", (bool*)&interpolateMode) && interpolateMode) {
+			// The control points become the points to pass through
+			interpolationPoints = curve.controlPoints;
+			activeInterpolationPoint = std::max((int)interpolationPoints.size() - 1, 0);
+			interpolateThroughPoints();
+		}
+		ImGui::SameLine();
+		if (ImGui::Checkbox("Centripetal", (bool*)&centripetal) && interpolateMode) {
+			interpolateThroughPoints();
+		}
+		if (interpolateMode) {
+			ImGui::Text("%d points, solved in %.2f ms, last drag update %.3f ms for %d control points",
+				(int)interpolationPoints.size(), interpolationTime, dragUpdateTime, dragUpdatedPoints);
+		}
+
+		ImGui::Text("Sketching:");
+		if (ImGui::Checkbox("Draw curve with left button", (bool*)&sketchMode) && sketchMode) {
+			interpolateMode = false;
+		}
+		ImGui::SameLine();
+		ImGui::PushItemWidth(100);
+		ImGui::DragFloat("Tolerance", (float*)&strokeFitter.tolerance, 0.001f, 0.001f, 1.0f);
+		ImGui::PopItemWidth();
+		if (strokeFitter.sampleCount() > 0) {
+			ImGui::Text("%d samples, %d spans (%d final), sample avg %.3f ms worst %.3f ms",
+				strokeFitter.sampleCount(), strokeFitter.spanCount(), strokeFitter.finalizedSpans(), strokeSampleTime, strokeWorstTime);
+		}
+
+		ImGui::Text("Knot refinement:");
+		if (ImGui::Button("Insert knot at demo point")) {
+			insertKnotAtDemoPoint();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Split every span")) {
+			splitEverySpan();
+		}
+
+		ImGui::Text("Least squares fit:");
+		ImGui::PushItemWidth(150);
+		ImGui::DragInt("Samples", (int*)&fitSamples, 1000, 2, 100000000);
+		ImGui::SameLine();
+		ImGui::DragInt("Control points", (int*)&fitControlPoints, 1, 2, 100000);
+		ImGui::SameLine();
+		ImGui::DragFloat("Noise", (float*)&fitNoise, 0.001f, 0.0f, 10.0f);
+		ImGui::PopItemWidth();
+		if (ImGui::Button("Fit noisy samples of the curve")) {
+			fitNoisySamples();
+		}
+		if (fitter.pointCount() > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%d points in %.1f ms, error rms %.4f max %.4f", fitter.pointCount(), fitTime, fitter.rmsError(), fitter.maxError);
+		}
+
+		ImGui::Text("Knot removal:");
+		ImGui::PushItemWidth(150);
+		ImGui::DragFloat("Removal tolerance", (float*)&knotRemover.tolerance, 0.0001f, 0.00001f, 1.0f, "%.5f");
+		ImGui::PopItemWidth();
+		ImGui::SameLine();
+		if (ImGui::Button("Remove knots")) {
+			removeKnots();
+		}
+		if (knotRemoval.pointsBefore > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%d to %d control points, error %.5f", knotRemoval.pointsBefore, knotRemoval.pointsAfter, knotRemoval.maxError);
+		}
+		if (ImGui::Button("Benchmark knot removal on refined copies")) {
+			benchmarkKnotRemoval();
+		}
+		if (scenePointsBefore > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%d curves, %d to %d control points in %.1f ms, worst error %.5f",
+				benchmarkCopies, scenePointsBefore, scenePointsAfter, knotRemovalTime, sceneRemovalError);
+		}
+
+		ImGui::Text("Order changes:");
+		if (ImGui::Button("Elevate order")) {
+			changeOrder(true);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Reduce order")) {
+			changeOrder(false);
+		}
+		ImGui::SameLine();
+		ImGui::PushItemWidth(150);
+		ImGui::DragFloat("Reduction tolerance", (float*)&orderChanger.tolerance, 0.0001f, 0.00001f, 1.0f, "%.5f");
+		ImGui::PopItemWidth();
+		if (orderChangeFailed) {
+			ImGui::Text("Reduction would move the curve by %.5f", orderChanger.maxError);
+		}
+		if (ImGui::Button("Benchmark fixed order evaluation")) {
+			benchmarkFixedOrder();
+		}
+		if (unifiedCurves > 0) {
+			ImGui::SameLine();
+			ImGui::Text("%d of %d curves to order %d in %.1f ms, evaluation %.1f ms mixed, %.1f ms fixed order",
+				unifiedCurves, benchmarkCopies, curve.order + 1, unifyTime, genericEvaluateTime, kernelEvaluateTime);
+		}
+
+		ImGui::Text("Hierarchical refinement:");
+		if (ImGui::Button("Refine at demo point")) {
+			refineAtDemoPoint();
+		}
+		if (hierarchyMemory.levels > 1 && hierarchy.represents(curve)) {
+			ImGui::SameLine();
+			ImGui::Text("%d levels, %d active functions", hierarchyMemory.levels, hierarchyMemory.activeFunctions);
+		}
+		ImGui::PushItemWidth(150);
+		ImGui::SliderInt("Detail levels", (int*)&detailLevels, 1, 12);
+		ImGui::PopItemWidth();
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark local detail")) {
+			benchmarkHierarchy();
+		}
+		if (detailMemory.levels > 0) {
+			ImGui::Text("%d levels in %.2f ms, shape moved %.2g: hierarchy %d functions %.1f KB, one B-spline %d points %.1f KB, every span split %d points %.1f KB",
+				detailMemory.levels, detailTime, detailShapeError, detailMemory.activeFunctions, detailMemory.hierarchyBytes / 1024.0f,
+				detailMemory.localPoints, detailMemory.localBytes / 1024.0f, detailMemory.globalPoints, detailMemory.globalBytes / 1024.0f);
+		}
+
+		ImGui::Text("History:");
+		if (ImGui::Button("Undo")) {
+			undo();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Redo")) {
+			redo();
+		}
+		ImGui::SameLine();
+		ImGui::Text("step %d of %d, last entry %.1f KB, all entries %.1f KB",
+			history.position() + 1, history.size(),
+			history.size() > 0 ? history.entryBytes(history.position()) / 1024.0f : 0.0f, history.totalBytes() / 1024.0f);
 
 		ImGui::End();
 	}
 }
 
-float oldOrder = 0;
 // Main loop
 void Program::mainLoop() {
 	
@@ -607,6 +2228,9 @@ void Program::mainLoop() {
 	clear_color = ImVec4(0.0f, 0.0f, 0.0f, 1.00f);
 	lineColor = ImVec4(1.0f, 1.0f, 0.0f, 1.00f);
 
+	// Every piece of curve geometry shares the transform set from the UI
+	curveTransform = renderEngine->createTransform();
+
 	// createTestGeometryObject();
 	createDemoPoint();
 	createKnots();
@@ -614,47 +2238,84 @@ void Program::mainLoop() {
 	createControlPoints();
 	createBsplineCurve();
 	createDemoLines();
-
-
+	createSelection();
+	createCurvatureComb();
+	createArcLengthMarkers();
+	createCursorProjection();
+	createIntersectionMarkers();
+	createInterpolationPoints();
+	history.commit(curve);
+
+	using Clock = std::chrono::steady_clock;
+	using Milliseconds = std::chrono::duration<float, std::milli>;
+
+	size_t allocationsAtFrameStart = AllocationCounter::count();
 	while(!glfwWindowShouldClose(window)) {
+		latencyTracker.mark(LatencyTracker::FrameStart, glfwGetTime());
 		glfwPollEvents();
+		latencyTracker.mark(LatencyTracker::Polled, glfwGetTime());
+		const Clock::time_point frameStart = Clock::now();
+		samplesEvaluated = 0;
+
+		clearKnots();
+		renderEngine->setTransform(curveTransform, modelTransform());
+		inverseModelTransform = glm::inverse(modelTransform());
+		curveToClip = renderEngine->getOrtho() * modelTransform();
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		viewportSize = glm::vec2(std::max(framebufferWidth, 1), std::max(framebufferHeight, 1));
+		controlPoints.visible = drawPoints;
+		activePoint.visible = drawPoints;
+		renderEngine->updateDrawState(controlPoints);
+		renderEngine->updateDrawState(activePoint);
+		const bool knotsVisible = drawKnots && !curve.knots.empty();
+		if(knotsVisible) {
+			placeKnots();
+		}
+
+		processInput();
 
-		resetPoints();
 		if(drawPoints) {
-			controlPoints->verts = controlPointSave;
-			activePoint->verts = activePointSave;
 			updateActivePoint();
 			updateControlPoints();
-			savePoints();
 		}
-
-		clearKnots();
-		if(drawKnots && !knots.empty())
-		{
+		updateSelection();
+		updateInterpolationPoints();
+		if(knotsVisible) {
 			updateActiveKnot();
 		}
+		latencyTracker.mark(LatencyTracker::InputApplied, glfwGetTime());
+
+		if (strokeChanged) {
+			writeStroke();
+		}
 
-		clearCurve();
-		if (controlPointSave.size() >= curveOrder && drawCurve) {
-			if(updateKnots || oldOrder!= curveOrder)
+		clearDemo();
+		const Clock::time_point evalStart = Clock::now();
+		// A new order needs new knots and a new solve
+		if (interpolateMode && oldOrder != curve.order) {
+			interpolateThroughPoints();
+		}
+		if (curve.controlPoints.size() >= curve.order && drawCurve) {
+			if(updateKnots || oldOrder!= curve.order)
 			{
+				// A closed curve repeats as many points as its order needs
+				if (knotMode == KnotMode::Closed && oldOrder != curve.order) {
+					curve.unwrapPoints((int)oldOrder - 1);
+					curve.wrapPoints(curve.order - 1);
+					activePointIndex = std::min(activePointIndex, (int)curve.controlPoints.size() - 1);
+					activePoint.setView(&curve.controlPoints, activePointIndex, 1);
+					pointGrid.build(curve.controlPoints);
+					selection.clear();
+				}
 				updateKnots = false;
-				oldOrder = curveOrder;
-				if (standardKnots) {
+				oldOrder = curve.order;
+				if (knotMode == KnotMode::Standard) {
 					createStandardKnots();
-					// standardKnots = false;
 				}
-				// if(uniformKnots)
-				// {
-				// 	createUniformKnots();
-				// 	// uniformKnots = false;
-				// }
-				// std::cout << "Knots: ";
-				// for (float knot : knots)
-				// {
-				// 	std::cout << knot << ",";
-				// }
-				// std::cout << std::endl;
+				else {
+					createUniformKnots();
+				}
 			}
 
 			updateBsplineCurve();
@@ -664,7 +2325,20 @@ void Program::mainLoop() {
 			if(drawDemoPoint) {
 				updateDemoPoint();
 			}
+			updateCurvatureComb();
+			updateArcLengthMarkers();
+			updateCursorProjection();
+			updateIntersectionMarkers();
+		}
+		else {
+			clearCurve();
+		}
+		if (historyPending) {
+			history.commit(curve);
+			historyPending = false;
 		}
+		const float evalTime = Milliseconds(Clock::now() - evalStart).count();
+		latencyTracker.mark(LatencyTracker::Tessellated, glfwGetTime());
 		
 		drawUI();
 
@@ -676,10 +2350,28 @@ void Program::mainLoop() {
 		glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		renderEngine->render(geometryObjects, glm::mat4(1.f));
+		const Clock::time_point renderStart = Clock::now();
+		renderEngine->render(glm::mat4(1.f));
+		const float renderTime = Milliseconds(Clock::now() - renderStart).count();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+		// Everything but the curve evaluation and our own draw calls counts as overhead
+		const float frameTime = Milliseconds(Clock::now() - frameStart).count();
+		resolutionController.update(evalTime, std::max(renderTime, renderEngine->getGpuRenderTime()), frameTime - evalTime - renderTime, samplesEvaluated);
+
+		latencyTracker.mark(LatencyTracker::Submitted, glfwGetTime());
 		glfwSwapBuffers(window);
+		// Optionally wait for the GPU so the timing covers the frame actually being drawn
+		if (finishAfterSwap) {
+			glFinish();
+		}
+		latencyTracker.mark(LatencyTracker::Presented, glfwGetTime());
+		latencyTracker.endFrame();
+
+		// Scratch from this frame is dead now
+		frameArena.reset();
+		heapAllocationsLastFrame = (int)(AllocationCounter::count() - allocationsAtFrameStart) + frameArena.lastFrameBlockAllocations;
+		allocationsAtFrameStart = AllocationCounter::count();
 	}
 
 	// Clean up, program needs to exit
@@ -7,12 +7,36 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <random>
 #include <vector>
 
+#include "AdaptiveTessellator.h"
+#include "ArcLengthTable.h"
+#include "Curve.h"
+#include "CurveHistory.h"
+#include "CurveIntersector.h"
+#include "CurveInterpolator.h"
+#include "CurveProjector.h"
+#include "EvaluationKernels.h"
+#include "FrameArena.h"
 #include "Geometry.h"
+#include "HierarchicalCurve.h"
 #include "InputHandler.h"
+#include "KnotRemover.h"
+#include "LatencyTracker.h"
+#include "LeastSquaresFitter.h"
+#include "OrderChanger.h"
+#include "Parallel.h"
+#include "PointGrid.h"
 #include "RenderEngine.h"
+#include "ResolutionController.h"
+#include "SpanBvh.h"
+#include "StrokeFitter.h"
+#include "SubdivisionRefiner.h"
+#include "UniformBasis.h"
 
 class Program {
 
@@ -24,8 +48,6 @@ private:
 	GLFWwindow* window;
 	RenderEngine* renderEngine;
 
-	std::vector<std::shared_ptr<Geometry>> geometryObjects;
-
 	bool show_test_window;
 	ImVec4 clear_color;
 
@@ -47,31 +69,102 @@ private:
 
 	// Use the geometry pointers and fill them with relavent data
 	// Methods for controlling the control points
-	void savePoints();
-	void resetPoints();
 	void addControlPoint(glm::vec3 oldPoint);
+	glm::mat4 modelTransform() const;
 	glm::vec4 fixMousePoisiton() const;
+	glm::vec3 mouseCurvePosition() const;
 	void addActivePoint();
 	void updateControlPoints();
 	bool selectControlPoint();
-	void moveActivePoint() const;
+	void moveControlPoint(int index, glm::vec3 position);
+	void moveActivePoint();
 	void removeActivePoint();
 	void updateActivePoint();
+	// Methods for region selection of control points
+	void createSelection();
+	void selectInRegion();
+	void updateSelection();
+	// Methods for consuming queued input
+	void processInput();
+	void handleInputEvent(const InputEvent& event);
+	// Methods for the edit history
+	void undo();
+	void redo();
+	void curveReplaced();
+	// Methods for refining the curve representation
+	void insertKnotAtDemoPoint();
+	void splitEverySpan();
+	void fitNoisySamples();
+	void removeKnots();
+	void benchmarkKnotRemoval();
+	void changeOrder(bool elevate);
+	void benchmarkFixedOrder();
+	void refineAtDemoPoint();
+	void benchmarkHierarchy();
+	// Methods for curves through the points the user places
+	void createInterpolationPoints();
+	void updateInterpolationPoints();
+	void interpolateThroughPoints();
+	bool selectInterpolationPoint();
+	void moveInterpolationPoint();
+	// Methods for fitting a curve to a freehand stroke while it is drawn
+	void beginStroke();
+	void continueStroke();
+	void writeStroke();
 	// Methods for controlling the resulting curves
 	void clearCurve();
-	int computeDelta(float &uValue);
-	glm::vec3 deBoorAlg(int delta, float uValue);
-	float deBoorAlgWeightsOnly(int delta, float uValue);
+	void clearDemo();
 	void updateBsplineCurve();
+	int curveResolution();
+	float sampleParameter(int sample) const;
+	void layoutBsplineCurve(int resolution);
+	void layoutBsplineCurveLod();
+	void updateFlatBsplineCurve();
+	void updateSubdividedBsplineCurve();
+	void benchmarkSubdivision();
+	int spanSegments(int delta);
+	void invalidateCurveSpans(int pointIndex);
+	float curveSpanPriority(int span) const;
+	void evaluateCurveSample(int sample, int delta);
+	void evaluateCurveSamples(int first, int count, int delta);
+	void evaluateFineSamples(int span, int begin, int end);
+	void refineBsplineCurve();
+	void completeCurveSpan(int span);
+	void cullBsplineCurve();
+	void bridgeCulledSpans();
+	bool segmentOnScreen(glm::vec3 start, glm::vec3 end) const;
+	bool selectCurve();
 	void deBoorAlgShow(int delta);
 	void updateDemoLines();
 	void updateDemoPoint();
+	void createCurvatureComb();
+	void updateCurvatureComb();
+	void createArcLengthMarkers();
+	void updateArcLengthMarkers();
+	void benchmarkArcLength();
+	void createCursorProjection();
+	void updateCursorProjection();
+	void benchmarkProjection();
+	void createIntersectionMarkers();
+	void updateIntersectionMarkers();
+	bool benchmarkScene(std::vector<Curve>& copies);
+	void benchmarkIntersections();
+	// How knots are made whenever the points change
+	enum class KnotMode {
+		Standard, // clamped, the curve starts and ends on its end points
+		Uniform,
+		Closed    // uniform, with the first order-1 points repeated at the end
+	};
 	// Methods for controlling knots
+	void setKnotMode(KnotMode mode);
+	int wrappedTwin(int index) const;
+	void benchmarkUniform();
 	void createKnots();
 	void createStandardKnots();
 	void createUniformKnots();
 	bool selectKnot();
 	void moveKnot();
+	void placeKnots();
 	void updateActiveKnot();
 
 
@@ -80,7 +173,6 @@ private:
 	float scale = 1;
 	float translation[2] = { 0, 0 };
 	
-	int curveOrder = 2;
 	int uIncrement = 100;
 	float demoU = 0;
 	
@@ -90,32 +182,227 @@ private:
 	bool drawDemoGeom = false;
 	bool drawDemoPoint = false;
 
-	bool standardKnots = true;
-	bool uniformKnots = false;
+	// Progressive refinement of the curve tessellation
+	bool progressiveRefine = false;
+	float refineBudget = 4.0f; // CPU milliseconds per frame spent refining
+	int coarseStride = 16;
+	int refineBacklog = 0;
+	int refineBacklogSpans = 0;
+
+	// Frame time driven control of the curve resolution
+	bool adaptiveResolution = false;
+	ResolutionController resolutionController;
+	int samplesEvaluated = 0;
+
+	// Scratch memory for everything that only lives during one frame
+	FrameArena frameArena;
+	int heapAllocationsLastFrame = 0;
+
+	KnotMode knotMode = KnotMode::Standard;
 	bool updateKnots = true;
 	bool drawKnots = true;
 
 	int activePointIndex = 0;
 	int activeKnotIndex = 0;
 
-	// Geometry storage for b-splines
-	std::shared_ptr<Geometry> controlPoints;
-	std::shared_ptr<Geometry> activePoint;
-	std::shared_ptr<Geometry> bsplineCurve;
-	std::shared_ptr<Geometry> demoLines;
-	std::shared_ptr<Geometry> demoPoint;
-	std::shared_ptr<Geometry> knotsRender;
-	std::shared_ptr<Geometry> activeKnot;
+	// Geometry storage for b-splines, all drawn in curve space except the knots
+	uint32_t curveTransform = 0;
+	Geometry controlPoints;
+	Geometry activePoint;
+	Geometry bsplineCurve;
+	Geometry demoLines;
+	Geometry demoPoint;
+	Geometry knotsRender;
+	Geometry activeKnot;
+	Geometry selectedPoints;
+	Geometry selectionOutline;
+	Geometry curvatureComb;
+	Geometry arcLengthMarkers;
+	Geometry cursorProjection;
+	Geometry intersectionMarkers;
+
+
+	// The curve being edited, the geometry above only views it
+	Curve curve;
+
+	// Curvature comb, teeth point away from the centre of curvature
+	bool drawCurvatureComb = false;
+	float combScale = 2.0f;
+	int combTeeth = 200;
+	std::vector<float> combParameters;
+	CurveDerivatives combDerivatives;
+
+	// Arc length parameterization, markers sit at equal distances along the curve
+	ArcLengthTable arcLength;
+	bool drawArcLengthMarkers = false;
+	int arcLengthMarkerCount = 20;
+	std::vector<float> markerLengths;
+	std::vector<float> markerParameters;
+	float arcLengthLookupRate = 0; // million lookups per second in the last benchmark
+
+	// Closest point queries, the cursor can show its projection onto the curve
+	CurveProjector projector;
+	bool projectCursor = false;
+	float projectionRate = 0; // million projections per second in the last benchmark
+
+	// Self intersections of the curve, and a scene of copies of it for the benchmark
+	CurveIntersector intersector;
+	std::vector<CurveIntersection> intersections;
+	bool drawSelfIntersections = false;
+	int benchmarkCopies = 64;
+	float intersectionTime = 0; // milliseconds for the last benchmark scene
+	int benchmarkIntersectionCount = 0;
+	long long bruteForceSpanPairs = 0;
+
+	// Interpolation mode, the curve passes through these points and the
+	// control points follow from them
+	bool interpolateMode = false;
+	bool centripetal = false;
+	CurveInterpolator interpolator;
+	std::vector<glm::vec3> interpolationPoints;
+	PointGrid interpolationGrid;
+	Geometry interpolationPointsRender;
+	int activeInterpolationPoint = 0;
+	float interpolationTime = 0; // milliseconds for the last full interpolation
+	float dragUpdateTime = 0;    // milliseconds for the last incremental update
+	int dragUpdatedPoints = 0;
+
+	// Knot removal within a tolerance, on the curve or on a scene of refined copies of it
+	KnotRemover knotRemover;
+	KnotRemovalReport knotRemoval;
+	float knotRemovalTime = 0; // milliseconds for the last scene
+	int scenePointsBefore = 0;
+	int scenePointsAfter = 0;
+	float sceneRemovalError = 0;
+
+	// Order changes that keep the shape, and a scene of mixed orders brought
+	// to one order so that a single fixed order kernel evaluates all of it
+	OrderChanger orderChanger;
+	bool orderChangeFailed = false;
+
+	// Hierarchical refinement, the curve is the combined hierarchy until it is edited
+	HierarchicalCurve hierarchy;
+	HierarchyMemory hierarchyMemory;
+	int detailLevels = 6;
+	HierarchyMemory detailMemory; // curve refined at a few spots, from the benchmark
+	float detailShapeError = 0;
+	float detailTime = 0;         // milliseconds
+	int unifiedCurves = 0;
+	float unifyTime = 0;          // milliseconds
+	float genericEvaluateTime = 0;
+	float kernelEvaluateTime = 0;
+
+	// Uniform knots give every span the same basis, samples then go through
+	// the matrix of the order instead of the de Boor recursion
+	const UniformBasis* uniformBasis = nullptr;
+	bool uniformFastPath = true;
+	float uniformGeneralTime = 0; // milliseconds for the benchmark samples
+	float uniformKernelTime = 0;
+	float uniformMatrixTime = 0;
+	float uniformSpanTime = 0;
+
+	// Sketch mode, a left button stroke is fitted as it is drawn and replaces the curve
+	bool sketchMode = false;
+	StrokeFitter strokeFitter;
+	bool strokeChanged = false; // the curve is rewritten once per frame, not per sample
+	float strokeSampleTime = 0; // average milliseconds per sample of the last stroke
+	float strokeWorstTime = 0;
+	double strokeTotalTime = 0;
+
+	// Least squares fit of noisy samples of the curve, streamed in chunks
+	LeastSquaresFitter fitter;
+	int fitSamples = 1000000;
+	int fitControlPoints = 20;
+	float fitNoise = 0.01f;
+	float fitTime = 0; // milliseconds for the measure, accumulate and solve passes
+
+	// Picking goes through a grid over the control points, queried in curve space
+	PointGrid pointGrid;
+	glm::mat4 inverseModelTransform = glm::mat4(1.f);
+	float pickTime = 0; // milliseconds spent in the last pick or region query
+
+	// Control points picked with a middle button box or lasso, sorted
+	std::vector<int> selection;
+	std::vector<glm::vec2> selectionPath; // screen space
+	bool lassoSelect = false;
+
+	// Finished edits are committed once the frame has updated the knots
+	CurveHistory history;
+	bool historyPending = false;
+
+	// Tessellation state, samples are grouped by the knot span they fall in
+	struct CurveSpan {
+		int delta;        // knot span index passed to deBoorAlg
+		int first;        // first sample of the span in curveSamples
+		int count;        // number of samples in the span
+		int refinedCount; // samples evaluated in order starting at first
+		bool coarse;      // every coarseStride-th sample has been evaluated
+		bool visible;     // bounds overlap the view, culled spans are neither evaluated nor drawn
+	};
+	std::vector<CurveSpan> curveSpans;
+	std::vector<glm::vec3> curveSamples;
+	std::vector<float> curveParameters; // u of every sample
+	bool curveLayoutDirty = true;
+	int tessellatedResolution = 0;
+
+	// How the curve is split into line segments
+	enum class TessellationMode {
+		Uniform,     // uIncrement steps over the whole curve
+		ScreenSpace, // samples per span follow the projected size of the span
+		Flatness,    // subdivision down to a curve space tolerance
+		Subdivision  // Lane-Riesenfeld rounds on the control polygon, uniform knots only
+	};
+	TessellationMode tessellationMode = TessellationMode::Uniform;
+
+	// Screen space LOD
+	float lodPixelError = 0.5f;
+	int maxSpanSegments = 4096;
+	glm::vec2 viewportSize = glm::vec2(1.f);
+	std::vector<CurveSpan> lodSpans;      // reused storage for a new layout
+	std::vector<glm::vec3> lodSamples;
+	std::vector<float> lodParameters;
 
+	// Flatness adaptive tessellation, redone whenever the curve changes
+	AdaptiveTessellator adaptiveTessellator;
+	std::vector<float> flatParameters;
+	bool flatTessellationStale = true;
+	float flatMaxError = 0;
+	int flatUniformVertices = 0; // uniform samples for the same error, 0 until measured
 
-	std::vector<glm::vec3> controlPointSave;
-	std::vector<glm::vec3> activePointSave;
+	// Subdivided control polygon, redone every frame since the rounds follow the zoom
+	SubdivisionRefiner subdivisionRefiner;
+	float subdivisionTime = 0;        // milliseconds per refinement, from the benchmark
+	float subdivisionDeBoorTime = 0;  // milliseconds for de Boor samples of the same count
+	float subdivisionError = 0;       // curve space distance of each polyline from the curve
+	float subdivisionDeBoorError = 0;
+	int subdivisionDeBoorVertices = 0; // de Boor samples for the error of the polygon
 
-	std::vector<float> knots;
+	// Span bounds for view culling and hit testing, refit as points move
+	SpanBvh spanBvh;
+	std::vector<int> spanQuery; // reused result storage for spanBvh queries
+	glm::mat4 curveToClip = glm::mat4(1.f);
+	bool cullCurve = true;
+	int culledSpans = 0;
 
-	std::vector<float> nurbValues = {1};
+	// What a held mouse button is currently doing
+	enum class MouseState {
+		Idle,
+		DragPoint,
+		DragKnot,
+		DragInterpolationPoint,
+		Sketch,
+		Select
+	};
+	MouseState mouseState = MouseState::Idle;
+	glm::vec2 mousePosition = glm::vec2(0);
+	bool coalesceMotion = true;
 
-	std::shared_ptr<glm::vec3> mousePosition;
+	// Input to present latency measurement
+	LatencyTracker latencyTracker;
+	bool vsync = true;
+	bool finishAfterSwap = false;
+	bool showLatencyHistogram = false;
+	std::vector<float> latencyHistogram = std::vector<float>(40);
 
 	ImVec4 lineColor;
 };
@@ -7,32 +7,69 @@ RenderEngine::RenderEngine(GLFWwindow* window) : window(window) {
 	ortho = glm::ortho(-10.0f * aspectRatio, 10.0f * aspectRatio, -10.0f, 10.0f, -1.0f, 1.0f);
 
 	mainProgram = ShaderTools::compileShaders("shaders/main.vert", "shaders/main.frag");
+	modelViewLocation = glGetUniformLocation(mainProgram, "modelView");
+	orthoLocation = glGetUniformLocation(mainProgram, "ortho");
+	colorLocation = glGetUniformLocation(mainProgram, "color");
+
+	// Transform 0 is the identity, used by everything drawn in screen space
+	registry.addTransform(glm::mat4(1.f));
 
 	// Set OpenGL state
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_LINE_SMOOTH);
 	glPointSize(30.0f);
 	glClearColor(1.0f, 1.0f, 1.0f, 0.0);
+
+	glGenQueries(2, timerQueries);
+	timerFrame = 0;
+	gpuRenderTime = 0;
 }
 
-// Called to render provided objects under view matrix
-void RenderEngine::render(const std::vector<std::shared_ptr<Geometry>>& objects, glm::mat4 view) {
+// Called to render every registered object under view matrix
+void RenderEngine::render(glm::mat4 view) {
 	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 	glUseProgram(mainProgram);
 
-	for (const std::shared_ptr<Geometry> o : objects) {
-		glBindVertexArray(o->vao);
+	// Collect the GPU time of the previous frame if it has finished
+	if (timerFrame > 0) {
+		GLuint available = 0;
+		glGetQueryObjectuiv(timerQueries[(timerFrame - 1) % 2], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(timerQueries[(timerFrame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+			gpuRenderTime = (float)elapsed / 1000000.0f;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, timerQueries[timerFrame % 2]);
 
-		glm::mat4 modelView = view * o->modelMatrix;
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "modelView"), 1, GL_FALSE, glm::value_ptr(modelView));
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "ortho"), 1, GL_FALSE, glm::value_ptr(ortho));
-		glUniform4fv(glGetUniformLocation(mainProgram, "color"), 1, &o->color[0]);
-		
+	glUniformMatrix4fv(orthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
 
-		glDrawArrays(o->drawMode, 0, o->verts.size());
-		// glDrawArrays(o->drawMode, 0, o->verts.size());
-		glBindVertexArray(0);
+	// Records are sorted by state, so uniforms only change between runs
+	registry.sort();
+	const std::vector<glm::mat4>& transforms = registry.transforms();
+	const std::vector<glm::vec4>& materials = registry.materials();
+	uint32_t boundTransform = UINT32_MAX;
+	uint32_t boundMaterial = UINT32_MAX;
+	for (const DrawRecord& record : registry.records()) {
+		if (!record.visible || record.count == 0) {
+			continue;
+		}
+		if (record.transform != boundTransform) {
+			const glm::mat4 modelView = view * transforms[record.transform];
+			glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, glm::value_ptr(modelView));
+			boundTransform = record.transform;
+		}
+		if (record.material != boundMaterial) {
+			glUniform4fv(colorLocation, 1, &materials[record.material][0]);
+			boundMaterial = record.material;
+		}
+		glBindVertexArray(record.vao);
+		glDrawArrays(record.drawMode, record.first, record.count);
 	}
+	glBindVertexArray(0);
+
+	glEndQuery(GL_TIME_ELAPSED);
+	timerFrame++;
 }
 
 // Assigns and binds buffers
@@ -48,24 +85,62 @@ void RenderEngine::assignBuffers(Geometry& object) {
 	glEnableVertexAttribArray(0);
 
 	glBindVertexArray(0);
+
+	// Register the draw call, it stays empty until the first update
+	object.material = registry.addMaterial(object.color);
+	object.handle = registry.add({ object.vao, 0, 0, object.drawMode, object.material, object.transform, object.layer, object.visible });
 }
 
 // Updates geometry in buffer
 void RenderEngine::updateBuffers(Geometry& object) {
-	// Updates data in buffer
+	// Updates data in buffer, straight from model storage for views
 	glBindBuffer(GL_ARRAY_BUFFER, object.vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * object.verts.size(), object.verts.data(), GL_DYNAMIC_DRAW);
+	const size_t count = object.vertexCount();
+	if (count > object.bufferCapacity) {
+		// Grow with headroom so adding points doesn't reallocate every time
+		object.bufferCapacity = std::max(count, object.bufferCapacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * object.bufferCapacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (count > 0) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * count, object.vertexData());
+	}
+	updateDrawState(object);
+}
+
+// Copies color, mode, visibility and vertex count into the draw record
+void RenderEngine::updateDrawState(Geometry& object) {
+	registry.setMaterial(object.material, object.color);
+	registry.update(object.handle, { object.vao, 0, (GLsizei)object.vertexCount(), object.drawMode, object.material, object.transform, object.layer, object.visible });
 }
 
 // Deletes buffers
 void RenderEngine::deleteBuffers(Geometry& object) {
+	registry.remove(object.handle);
 	glDeleteBuffers(1, &object.vertexBuffer);
 	glDeleteVertexArrays(1, &object.vao);
 }
 
+// Registers a new model transform, initially the identity
+uint32_t RenderEngine::createTransform() {
+	return registry.addTransform(glm::mat4(1.f));
+}
+
+void RenderEngine::setTransform(uint32_t transform, const glm::mat4& matrix) {
+	registry.setTransform(transform, matrix);
+}
+
 // Sets projection and viewport for new width and height
 void RenderEngine::setWindowSize(int width, int height) {
 	glViewport(0, 0, width, height);
 	float aspectRatio = ((float)width / (float)height);
 	ortho = glm::ortho(-10.0f * aspectRatio, 10.0f * aspectRatio, -10.0f, 10.0f, -1.0f, 1.0f);
 }
+
+// GPU time in milliseconds spent drawing the most recently completed frame
+float RenderEngine::getGpuRenderTime() const {
+	return gpuRenderTime;
+}
+
+const glm::mat4& RenderEngine::getOrtho() const {
+	return ortho;
+}
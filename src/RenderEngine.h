@@ -7,6 +7,7 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <vector>
 
 #include "Geometry.h"
@@ -17,17 +18,32 @@ class RenderEngine {
 public:
 	RenderEngine(GLFWwindow* window);
 
-	void render(const std::vector<std::shared_ptr<Geometry>>& objects, glm::mat4 view);
+	void render(glm::mat4 view);
 	void assignBuffers(Geometry& object);
 	void updateBuffers(Geometry& object);
+	void updateDrawState(Geometry& object);
 	void deleteBuffers(Geometry& object);
+	uint32_t createTransform();
+	void setTransform(uint32_t transform, const glm::mat4& matrix);
 	void setWindowSize(int width, int height);
+	float getGpuRenderTime() const;
+	const glm::mat4& getOrtho() const;
 
 private:
 	GLFWwindow* window;
 
 	GLuint mainProgram;
+	GLint modelViewLocation;
+	GLint orthoLocation;
+	GLint colorLocation;
+
+	RenderRegistry registry;
 
 	glm::mat4 ortho;
+
+	// Timer queries alternate between frames so reading a result never stalls
+	GLuint timerQueries[2];
+	int timerFrame;
+	float gpuRenderTime;
 };
 
@@ -0,0 +1,114 @@
+#include "RenderRegistry.h"
+
+#include <algorithm>
+#include <numeric>
+
+RenderHandle RenderRegistry::add(const DrawRecord& record) {
+	uint32_t slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		slot = slots.size();
+		slots.push_back({ 0, 0 });
+	}
+	slots[slot].record = drawRecords.size();
+	drawRecords.push_back(record);
+	recordSlots.push_back(slot);
+	sorted = false;
+	return { slot, slots[slot].generation };
+}
+
+// Swaps the last record into the hole so the arrays stay dense
+void RenderRegistry::remove(RenderHandle handle) {
+	if (!isValid(handle)) {
+		return;
+	}
+	const uint32_t index = slots[handle.slot].record;
+	const uint32_t last = drawRecords.size() - 1;
+	drawRecords[index] = drawRecords[last];
+	recordSlots[index] = recordSlots[last];
+	slots[recordSlots[index]].record = index;
+	drawRecords.pop_back();
+	recordSlots.pop_back();
+
+	slots[handle.slot].generation++;
+	freeSlots.push_back(handle.slot);
+	sorted = false;
+}
+
+bool RenderRegistry::isValid(RenderHandle handle) const {
+	return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+}
+
+const DrawRecord& RenderRegistry::get(RenderHandle handle) const {
+	return drawRecords[slots[handle.slot].record];
+}
+
+// Only changes to the sort key cost a re-sort, ranges and visibility are free
+void RenderRegistry::update(RenderHandle handle, const DrawRecord& record) {
+	DrawRecord& current = drawRecords[slots[handle.slot].record];
+	if (current.layer != record.layer || current.transform != record.transform || current.material != record.material) {
+		sorted = false;
+	}
+	current = record;
+}
+
+uint32_t RenderRegistry::addMaterial(glm::vec4 color) {
+	materialColors.push_back(color);
+	return materialColors.size() - 1;
+}
+
+void RenderRegistry::setMaterial(uint32_t material, glm::vec4 color) {
+	materialColors[material] = color;
+}
+
+uint32_t RenderRegistry::addTransform(const glm::mat4& transform) {
+	transformMatrices.push_back(transform);
+	return transformMatrices.size() - 1;
+}
+
+void RenderRegistry::setTransform(uint32_t transform, const glm::mat4& matrix) {
+	transformMatrices[transform] = matrix;
+}
+
+// Orders records by layer first, then by transform and material so the
+// renderer only changes uniforms when the state actually differs
+void RenderRegistry::sort() {
+	if (sorted) {
+		return;
+	}
+	std::vector<uint32_t> order(drawRecords.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		const DrawRecord& x = drawRecords[a];
+		const DrawRecord& y = drawRecords[b];
+		if (x.layer != y.layer) return x.layer < y.layer;
+		if (x.transform != y.transform) return x.transform < y.transform;
+		return x.material < y.material;
+	});
+
+	std::vector<DrawRecord> records(drawRecords.size());
+	std::vector<uint32_t> owners(drawRecords.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		records[i] = drawRecords[order[i]];
+		owners[i] = recordSlots[order[i]];
+		slots[owners[i]].record = i;
+	}
+	drawRecords.swap(records);
+	recordSlots.swap(owners);
+	sorted = true;
+}
+
+const std::vector<DrawRecord>& RenderRegistry::records() const {
+	return drawRecords;
+}
+
+const std::vector<glm::vec4>& RenderRegistry::materials() const {
+	return materialColors;
+}
+
+const std::vector<glm::mat4>& RenderRegistry::transforms() const {
+	return transformMatrices;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+// Stable reference to a draw record, stale once the record is removed
+struct RenderHandle {
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Everything needed to issue one draw call
+struct DrawRecord {
+	GLuint vao;
+	GLint first;
+	GLsizei count;
+	GLenum drawMode;
+	uint32_t material;  // index into materials()
+	uint32_t transform; // index into transforms()
+	int layer;          // lower layers draw first and win the depth test
+	bool visible;
+};
+
+// Dense arrays of draw records, colors and transforms. Records are kept
+// sorted by layer and render state so drawing is a linear scan.
+class RenderRegistry {
+
+public:
+	RenderHandle add(const DrawRecord& record);
+	void remove(RenderHandle handle);
+	bool isValid(RenderHandle handle) const;
+	const DrawRecord& get(RenderHandle handle) const;
+	void update(RenderHandle handle, const DrawRecord& record);
+
+	uint32_t addMaterial(glm::vec4 color);
+	void setMaterial(uint32_t material, glm::vec4 color);
+	uint32_t addTransform(const glm::mat4& transform);
+	void setTransform(uint32_t transform, const glm::mat4& matrix);
+
+	void sort();
+	const std::vector<DrawRecord>& records() const;
+	const std::vector<glm::vec4>& materials() const;
+	const std::vector<glm::mat4>& transforms() const;
+
+private:
+	struct Slot {
+		uint32_t record;
+		uint32_t generation;
+	};
+
+	std::vector<DrawRecord> drawRecords;
+	std::vector<uint32_t> recordSlots; // slot owning each record
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<glm::vec4> materialColors;
+	std::vector<glm::mat4> transformMatrices;
+	bool sorted = true;
+};
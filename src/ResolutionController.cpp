@@ -0,0 +1,60 @@
+#include "ResolutionController.h"
+
+ResolutionController::ResolutionController() {
+	effectiveResolution = 0;
+	requestedResolution = 0;
+	framesSinceChange = 0;
+	evalTime = 0;
+	renderTime = 0;
+	overheadTime = 0;
+	costPerSample = 0;
+}
+
+// Exponential moving average used for all of the frame measurements
+float ResolutionController::smooth(float average, float sample) {
+	return average + 0.1f * (sample - average);
+}
+
+// Feed the timings of the last frame, all in milliseconds
+void ResolutionController::update(float evalTime, float renderTime, float otherTime, int samplesEvaluated) {
+	this->evalTime = smooth(this->evalTime, evalTime);
+	this->renderTime = smooth(this->renderTime, renderTime);
+	overheadTime = smooth(overheadTime, renderTime + otherTime);
+	// Frames that only redraw tell us nothing about evaluation cost
+	if (samplesEvaluated >= 64) {
+		const float cost = evalTime / (float)samplesEvaluated;
+		costPerSample = costPerSample == 0 ? cost : smooth(costPerSample, cost);
+	}
+	framesSinceChange++;
+
+	if (costPerSample <= 0 || requestedResolution <= 0) {
+		return;
+	}
+
+	// Number of samples a full re-tessellation can afford inside the target
+	const float available = std::max(targetFrameTime - overheadTime, 0.0f);
+	const int desired = std::clamp((int)(available / costPerSample), std::min(minResolution, requestedResolution), requestedResolution);
+
+	// Only move once the desired budget has drifted far enough away, and be
+	// quicker to back off than to ramp up again
+	const float change = (float)(desired - effectiveResolution) / (float)std::max(effectiveResolution, 1);
+	const bool overTarget = overheadTime + this->evalTime > targetFrameTime * (1.0f + hysteresis);
+	if ((change < -hysteresis && (overTarget || framesSinceChange >= cooldownFrames / 2)) ||
+		(change > hysteresis && framesSinceChange >= cooldownFrames)) {
+		// Quantize so small fluctuations don't force a full re-layout
+		const int step = std::max(requestedResolution / 64, 1);
+		effectiveResolution = std::clamp((desired / step) * step, std::min(minResolution, requestedResolution), requestedResolution);
+		framesSinceChange = 0;
+	}
+}
+
+// Sample count to use for a curve the user asked to draw with requested samples
+int ResolutionController::sampleBudget(int requested) {
+	if (requested != requestedResolution) {
+		// Start from the user's setting and let the loop pull it down if needed
+		requestedResolution = requested;
+		effectiveResolution = requested;
+		framesSinceChange = 0;
+	}
+	return effectiveResolution;
+}
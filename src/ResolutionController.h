@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Closed loop controller that picks the curve sample count so a full
+// re-tessellation plus rendering fits inside a target frame time.
+class ResolutionController {
+
+public:
+	ResolutionController();
+
+	void update(float evalTime, float renderTime, float otherTime, int samplesEvaluated);
+	int sampleBudget(int requested);
+
+	float targetFrameTime = 12.0f; // milliseconds
+	float hysteresis = 0.2f;       // relative change needed before the budget moves
+	int cooldownFrames = 30;       // frames to wait between two increases
+	int minResolution = 16;
+
+	int effectiveResolution;
+	float evalTime;
+	float renderTime;
+	float costPerSample;
+
+private:
+	int requestedResolution;
+	int framesSinceChange;
+	float overheadTime;
+
+	static float smooth(float average, float sample);
+};
@@ -0,0 +1,192 @@
+#include "SpanBvh.h"
+
+#include <algorithm>
+
+bool SpanBounds::empty() const {
+	return min.x > max.x;
+}
+
+bool SpanBounds::overlaps(const SpanBounds& other) const {
+	return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+}
+
+// Distance from a point to the box, 0 inside it
+float SpanBounds::distance(glm::vec2 point) const {
+	if (empty()) {
+		return 1e30f;
+	}
+	return glm::length(glm::max(glm::max(min - point, point - max), glm::vec2(0.0f)));
+}
+
+void SpanBounds::expand(glm::vec2 point) {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void SpanBounds::expand(const SpanBounds& other) {
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+}
+
+// Box around the control points of one span, empty for zero length spans
+SpanBounds SpanBvh::spanHull(const Curve& curve, int delta) const {
+	SpanBounds hull;
+	if (curve.knots[delta] < curve.knots[delta + 1]) {
+		for (int i = delta - order + 1; i <= delta; i++) {
+			hull.expand(glm::vec2(curve.controlPoints[i]));
+		}
+	}
+	return hull;
+}
+
+void SpanBvh::build(const Curve& curve) {
+	clear();
+	order = curve.order;
+	if (curve.controlPoints.size() < order || curve.knots.size() != curve.controlPoints.size() + order) {
+		return;
+	}
+	// Spans order-1 .. n-1 are the ones the clamped curve is defined on
+	first = order - 1;
+	count = (int)curve.controlPoints.size() - order + 1;
+	leafOffset = 1;
+	while (leafOffset < count) {
+		leafOffset *= 2;
+	}
+	nodes.assign(2 * leafOffset, SpanBounds());
+	for (int i = 0; i < count; i++) {
+		nodes[leafOffset + i] = spanHull(curve, first + i);
+	}
+	for (int n = leafOffset - 1; n >= 1; n--) {
+		nodes[n] = nodes[2 * n];
+		nodes[n].expand(nodes[2 * n + 1]);
+	}
+}
+
+// A control point moved, only the spans it belongs to and their ancestors change
+void SpanBvh::refit(const Curve& curve, int pointIndex) {
+	if (count == 0 || curve.order != order || (int)curve.controlPoints.size() != count + order - 1) {
+		return;
+	}
+	const int low = std::max(pointIndex, first);
+	const int high = std::min(pointIndex + order - 1, first + count - 1);
+	for (int delta = low; delta <= high; delta++) {
+		int n = leafOffset + delta - first;
+		nodes[n] = spanHull(curve, delta);
+		for (n /= 2; n >= 1; n /= 2) {
+			nodes[n] = nodes[2 * n];
+			nodes[n].expand(nodes[2 * n + 1]);
+		}
+	}
+}
+
+void SpanBvh::clear() {
+	nodes.clear();
+	count = 0;
+	first = 0;
+	leafOffset = 0;
+}
+
+int SpanBvh::firstSpan() const {
+	return first;
+}
+
+int SpanBvh::spanCount() const {
+	return count;
+}
+
+const SpanBounds& SpanBvh::bounds() const {
+	static const SpanBounds none;
+	return count == 0 ? none : nodes[1];
+}
+
+const SpanBounds& SpanBvh::spanBounds(int delta) const {
+	return nodes[leafOffset + delta - first];
+}
+
+void SpanBvh::query(const SpanBounds& region, std::vector<int>& deltas) const {
+	if (count > 0) {
+		queryNode(1, region, deltas);
+	}
+}
+
+void SpanBvh::queryNode(int node, const SpanBounds& region, std::vector<int>& deltas) const {
+	if (nodes[node].empty() || !nodes[node].overlaps(region)) {
+		return;
+	}
+	if (node >= leafOffset) {
+		deltas.push_back(first + node - leafOffset);
+		return;
+	}
+	queryNode(2 * node, region, deltas);
+	queryNode(2 * node + 1, region, deltas);
+}
+
+void SpanBvh::nearest(glm::vec2 point, float best, const std::function<float(int delta, float best)>& visit) const {
+	if (count > 0) {
+		nearestNode(1, point, best, visit);
+	}
+}
+
+void SpanBvh::nearestNode(int node, glm::vec2 point, float& best, const std::function<float(int, float)>& visit) const {
+	if (nodes[node].distance(point) >= best) {
+		return;
+	}
+	if (node >= leafOffset) {
+		best = visit(first + node - leafOffset, best);
+		return;
+	}
+	// The closer child first, it is the one most likely to shrink best
+	int near = 2 * node;
+	int far = 2 * node + 1;
+	if (nodes[far].distance(point) < nodes[near].distance(point)) {
+		std::swap(near, far);
+	}
+	nearestNode(near, point, best, visit);
+	nearestNode(far, point, best, visit);
+}
+
+void SpanBvh::overlappingPairs(const SpanBvh& a, const SpanBvh& b, std::vector<std::pair<int, int>>& pairs) {
+	if (a.count > 0 && b.count > 0) {
+		pairNodes(a, 1, b, 1, &a == &b, pairs);
+	}
+}
+
+// Descends both trees at once, a self query only visits each unordered pair once
+void SpanBvh::pairNodes(const SpanBvh& a, int nodeA, const SpanBvh& b, int nodeB, bool self, std::vector<std::pair<int, int>>& pairs) {
+	if (self && nodeA > nodeB) {
+		return;
+	}
+	const SpanBounds& boundsA = a.nodes[nodeA];
+	const SpanBounds& boundsB = b.nodes[nodeB];
+	if (boundsA.empty() || boundsB.empty() || !boundsA.overlaps(boundsB)) {
+		return;
+	}
+	const bool leafA = nodeA >= a.leafOffset;
+	const bool leafB = nodeB >= b.leafOffset;
+	if (leafA && leafB) {
+		if (!self || nodeA != nodeB) {
+			pairs.emplace_back(a.first + nodeA - a.leafOffset, b.first + nodeB - b.leafOffset);
+		}
+		return;
+	}
+	// In a self query both nodes sit on the same level, so they split together
+	if (self) {
+		pairNodes(a, 2 * nodeA, b, 2 * nodeB, self, pairs);
+		pairNodes(a, 2 * nodeA, b, 2 * nodeB + 1, self, pairs);
+		pairNodes(a, 2 * nodeA + 1, b, 2 * nodeB + 1, self, pairs);
+		if (nodeA != nodeB) {
+			pairNodes(a, 2 * nodeA + 1, b, 2 * nodeB, self, pairs);
+		}
+		return;
+	}
+	// Otherwise split whichever box is larger
+	const glm::vec2 sizeA = boundsA.max - boundsA.min;
+	const glm::vec2 sizeB = boundsB.max - boundsB.min;
+	if (!leafA && (leafB || sizeA.x * sizeA.y >= sizeB.x * sizeB.y)) {
+		pairNodes(a, 2 * nodeA, b, nodeB, self, pairs);
+		pairNodes(a, 2 * nodeA + 1, b, nodeB, self, pairs);
+		return;
+	}
+	pairNodes(a, nodeA, b, 2 * nodeB, self, pairs);
+	pairNodes(a, nodeA, b, 2 * nodeB + 1, self, pairs);
+}
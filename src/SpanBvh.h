@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "Curve.h"
+
+// Axis aligned box in the xy plane, empty until something is added to it
+struct SpanBounds {
+	glm::vec2 min = glm::vec2(1e30f);
+	glm::vec2 max = glm::vec2(-1e30f);
+
+	bool empty() const;
+	bool overlaps(const SpanBounds& other) const;
+	float distance(glm::vec2 point) const;
+	void expand(glm::vec2 point);
+	void expand(const SpanBounds& other);
+};
+
+// Bounding volume hierarchy over the knot spans of a curve. By the convex
+// hull property the piece of curve over span delta lies inside the box of
+// control points delta-order+1 .. delta, so the boxes are conservative.
+// The tree is a complete binary tree stored in an array, leaf i holding
+// span firstSpan()+i, which keeps refits down to one path per span.
+class SpanBvh {
+
+public:
+	void build(const Curve& curve);
+	void refit(const Curve& curve, int pointIndex);
+	void clear();
+
+	int firstSpan() const;
+	int spanCount() const;
+	const SpanBounds& bounds() const;
+	const SpanBounds& spanBounds(int delta) const;
+
+	// Knot spans whose bounds overlap the region, in increasing order
+	void query(const SpanBounds& region, std::vector<int>& deltas) const;
+	// Visits spans nearest bounds first. visit gets the span and the best
+	// distance so far and returns the new best, bounds further away are skipped.
+	void nearest(glm::vec2 point, float best, const std::function<float(int delta, float best)>& visit) const;
+	// Span pairs whose bounds overlap, with a < b when both come from the same tree
+	static void overlappingPairs(const SpanBvh& a, const SpanBvh& b, std::vector<std::pair<int, int>>& pairs);
+
+private:
+	int order = 0;
+	int first = 0;
+	int count = 0;
+	int leafOffset = 0;
+	std::vector<SpanBounds> nodes; // 1 is the root, children of n are 2n and 2n+1
+
+	SpanBounds spanHull(const Curve& curve, int delta) const;
+	void queryNode(int node, const SpanBounds& region, std::vector<int>& deltas) const;
+	void nearestNode(int node, glm::vec2 point, float& best, const std::function<float(int, float)>& visit) const;
+	static void pairNodes(const SpanBvh& a, int nodeA, const SpanBvh& b, int nodeB, bool self, std::vector<std::pair<int, int>>& pairs);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed size lock-free ring buffer for exactly one producer thread and one
+// consumer thread. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	// Producer side, returns false and drops the item when the queue is full
+	bool push(const T& item) {
+		const size_t write = tail.load(std::memory_order_relaxed);
+		if (write - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		items[write & (Capacity - 1)] = item;
+		tail.store(write + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, returns false when there is nothing to read
+	bool pop(T& item) {
+		const size_t read = head.load(std::memory_order_relaxed);
+		if (read == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = items[read & (Capacity - 1)];
+		head.store(read + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, the oldest item without removing it or nullptr if empty
+	const T* peek() const {
+		const size_t read = head.load(std::memory_order_relaxed);
+		if (read == tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &items[read & (Capacity - 1)];
+	}
+
+	size_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::array<T, Capacity> items;
+
+	// Kept on separate cache lines so the two threads don't false share
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
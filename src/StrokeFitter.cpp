@@ -0,0 +1,168 @@
+#include "StrokeFitter.h"
+
+#include <algorithm>
+#include <memory_resource>
+
+void StrokeFitter::begin(int order) {
+	shape = Curve();
+	shape.order = std::max(order, 2);
+	window.clear();
+	samples = 0;
+	length = 0;
+	maxError = 0;
+	basis.resize(shape.order);
+}
+
+int StrokeFitter::sampleCount() const {
+	return samples;
+}
+
+int StrokeFitter::spanCount() const {
+	return shape.controlPoints.empty() ? 0 : (int)shape.controlPoints.size() - shape.order + 1;
+}
+
+int StrokeFitter::finalizedSpans() const {
+	return std::max(spanCount() - activeSpans(), 0);
+}
+
+// A new knot changes the basis functions up to order spans back, the window covers them all
+int StrokeFitter::activeSpans() const {
+	return std::max(windowSpans, shape.order);
+}
+
+// Control points that only reach into the window, the first point stays on the first sample
+int StrokeFitter::firstFreePoint() const {
+	const int finalized = finalizedSpans();
+	return finalized == 0 ? 1 : finalized + shape.order - 1;
+}
+
+// The clamped end knots follow the stroke as it grows
+void StrokeFitter::setEnd(float u) {
+	for (int i = (int)shape.controlPoints.size(); i < (int)shape.knots.size(); i++) {
+		shape.knots[i] = u;
+	}
+}
+
+void StrokeFitter::addSample(glm::vec3 point) {
+	if (samples > 0 && glm::distance(point, window.back().point) < 0.1f * tolerance) {
+		return;
+	}
+	const float previousEnd = length;
+	if (samples > 0) {
+		length += glm::distance(point, window.back().point);
+	}
+	window.push_back({ point, length });
+	samples++;
+	if (samples < 2) {
+		return;
+	}
+
+	// The second sample gives the first span, a straight line to start from
+	const int order = shape.order;
+	if (shape.controlPoints.empty()) {
+		const glm::vec3 start = window.front().point;
+		for (int i = 0; i < order; i++) {
+			shape.controlPoints.push_back(start + (point - start) * ((float)i / (order - 1)));
+		}
+		shape.weights.assign(order, 1.0f);
+		shape.knots.assign(order, 0.0f);
+		shape.knots.resize(2 * order, length);
+		solveWindow();
+		return;
+	}
+
+	// A long span at a high input rate would make the window grow without
+	// bound, it is closed once it holds its share of maxWindowSamples
+	const float lastSpanStart = shape.knots[shape.controlPoints.size() - 1];
+	const auto lastSpan = std::find_if(window.begin(), window.end(), [&](const Sample& sample) {
+		return sample.u >= lastSpanStart;
+	});
+	const bool full = window.end() - lastSpan > maxWindowSamples / activeSpans();
+	setEnd(length);
+	solveWindow();
+	if ((full || maxError > tolerance) && previousEnd > lastSpanStart) {
+		// The last span is split at the previous sample, the new sample starts a span of its own
+		shape.insertKnot(previousEnd);
+		// Samples before the window are done with
+		const float windowStart = shape.knots[finalizedSpans() + order - 1];
+		window.erase(window.begin(), std::find_if(window.begin(), window.end(), [&](const Sample& sample) {
+			return sample.u >= windowStart;
+		}));
+		solveWindow();
+	}
+}
+
+// Least squares for the free control points against the window samples,
+// the fixed points are moved to the right hand side. The damping term keeps
+// the system positive definite when the newest span holds a single sample.
+void StrokeFitter::solveWindow() {
+	const int order = shape.order;
+	const int degree = order - 1;
+	const int firstFree = firstFreePoint();
+	const int freeCount = (int)shape.controlPoints.size() - firstFree;
+	if (freeCount <= 0) {
+		return;
+	}
+	normals.resize(freeCount, degree);
+	rhs.assign(freeCount, glm::dvec3(0));
+	for (int i = 0; i < freeCount; i++) {
+		normals.at(i, i) = damping;
+		rhs[i] = (double)damping * glm::dvec3(shape.controlPoints[firstFree + i]);
+	}
+
+	// Stack scratch for the basis, only very high orders reach the heap
+	alignas(16) unsigned char buffer[16384];
+	std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+	std::pmr::unsynchronized_pool_resource pool(&scratch);
+	for (const Sample& sample : window) {
+		const int delta = shape.findSpan(sample.u);
+		shape.basisDerivatives(delta, sample.u, 0, basis.data(), &pool);
+		glm::dvec3 remainder = glm::dvec3(sample.point);
+		for (int a = 0; a < order; a++) {
+			const int point = delta - degree + a;
+			if (point < firstFree) {
+				remainder -= (double)basis[a] * glm::dvec3(shape.controlPoints[point]);
+			}
+		}
+		for (int a = 0; a < order; a++) {
+			const int row = delta - degree + a - firstFree;
+			if (row < 0) {
+				continue;
+			}
+			rhs[row] += (double)basis[a] * remainder;
+			for (int b = 0; b <= a; b++) {
+				const int column = delta - degree + b - firstFree;
+				if (column >= 0) {
+					normals.at(row, column) += (double)basis[a] * basis[b];
+				}
+			}
+		}
+	}
+	if (!normals.factorize()) {
+		return;
+	}
+	normals.solve(rhs.data());
+	for (int i = 0; i < freeCount; i++) {
+		shape.controlPoints[firstFree + i] = glm::vec3(rhs[i]);
+	}
+
+	maxError = 0;
+	for (const Sample& sample : window) {
+		const glm::vec3 fitted = shape.evaluate(shape.findSpan(sample.u), sample.u, &pool);
+		maxError = std::max(maxError, glm::distance(fitted, sample.point));
+	}
+}
+
+bool StrokeFitter::write(Curve& curve) const {
+	if (shape.controlPoints.empty() || length <= 0) {
+		return false;
+	}
+	curve.order = shape.order;
+	curve.controlPoints = shape.controlPoints;
+	curve.weights = shape.weights;
+	curve.knots.resize(shape.knots.size());
+	for (size_t i = 0; i < shape.knots.size(); i++) {
+		curve.knots[i] = std::min(shape.knots[i] / length, 1.0f);
+	}
+	return true;
+}
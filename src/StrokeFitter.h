@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "BandMatrix.h"
+#include "Curve.h"
+
+// Fits a B-spline to a freehand stroke while it is being drawn. Samples are
+// parameterized by arc length and only the last windowSpans spans stay open:
+// the control points that reach no further back are refit by damped least
+// squares against the samples of those spans after every new sample, and
+// everything before is final and never touched again. When the fit misses a
+// sample by more than the tolerance, or the last span holds its share of
+// maxWindowSamples, a knot goes in at the previous sample and the window
+// moves on. Knot insertion keeps the shape, so closing a span doesn't move
+// it, and every sample costs at most a solve over maxWindowSamples samples.
+class StrokeFitter {
+
+public:
+	float tolerance = 0.02f;     // curve space
+	int windowSpans = 4;         // raised to the order if smaller
+	int maxWindowSamples = 256;
+	float damping = 1e-3f;       // pull of free control points towards where they were
+
+	void begin(int order);
+	// Samples closer than a tenth of the tolerance to the previous one are skipped
+	void addSample(glm::vec3 point);
+	// The stroke so far with knots scaled to [0, 1], nothing until it has length
+	bool write(Curve& curve) const;
+
+	int sampleCount() const;
+	int spanCount() const;
+	int finalizedSpans() const;
+	float maxError = 0; // largest distance of a window sample from the fit
+
+private:
+	struct Sample {
+		glm::vec3 point;
+		float u; // arc length up to the sample
+	};
+
+	Curve shape; // knots run over [0, length]
+	std::vector<Sample> window;
+	int samples = 0;
+	float length = 0;
+	SymmetricBandMatrix normals;
+	std::vector<glm::dvec3> rhs;
+	std::vector<float> basis;
+
+	int activeSpans() const;
+	int firstFreePoint() const;
+	void setEnd(float u);
+	void solveWindow();
+};
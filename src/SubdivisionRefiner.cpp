@@ -0,0 +1,142 @@
+#include "SubdivisionRefiner.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// The polygon of a uniform B-spline of degree p stays within c_p max |P[i-1]
+// - 2 P[i] + P[i+1]| of the curve. Measured on random polygons, rounded up.
+float secondDifferenceBound(int degree) {
+	static const float bounds[] = { 0.0f, 0.0f, 0.125f, 0.1667f, 0.25f, 0.3f, 0.375f, 0.42f, 0.5f };
+	return degree < 9 ? bounds[degree] : degree / 16.0f;
+}
+
+void doubleAndAverage(std::vector<float>& a, int count, int degree) {
+	for (int i = count - 1; i >= 0; i--) {
+		a[2 * i + 1] = a[2 * i] = a[i];
+	}
+	// Each pass reads a[i + 1] before the next iteration overwrites it
+	float* data = a.data();
+	for (int r = 0, last = 2 * count - 1; r < degree; r++, last--) {
+		for (int i = 0; i < last; i++) {
+			data[i] = 0.5f * (data[i] + data[i + 1]);
+		}
+	}
+}
+
+}
+
+void SubdivisionRefiner::refine(const Curve& curve, const glm::mat4& toPixels) {
+	degree = curve.order - 1;
+	count = (int)curve.controlPoints.size();
+	rounds = 0;
+	rational = std::any_of(curve.weights.begin(), curve.weights.end(), [](float weight) { return weight != 1.0f; });
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	w.resize(rational ? count : 0);
+	for (int i = 0; i < count; i++) {
+		const float weight = rational ? curve.weights[i] : 1.0f;
+		x[i] = curve.controlPoints[i].x * weight;
+		y[i] = curve.controlPoints[i].y * weight;
+		z[i] = curve.controlPoints[i].z * weight;
+		if (rational) {
+			w[i] = weight;
+		}
+	}
+	polygonError = flatness(toPixels);
+	while (degree > 1 && rounds < maxRounds && polygonError > pixelTolerance) {
+		subdivide();
+		rounds++;
+		polygonError = flatness(toPixels);
+	}
+}
+
+void SubdivisionRefiner::subdivide() {
+	const int refined = 2 * count - degree;
+	x.resize(2 * count);
+	y.resize(2 * count);
+	z.resize(2 * count);
+	doubleAndAverage(x, count, degree);
+	doubleAndAverage(y, count, degree);
+	doubleAndAverage(z, count, degree);
+	if (rational) {
+		w.resize(2 * count);
+		doubleAndAverage(w, count, degree);
+	}
+	count = refined;
+}
+
+// Second differences taken after the mapping to pixels, which for an affine
+// mapping is the linear part applied to the second differences of the points
+float SubdivisionRefiner::flatness(const glm::mat4& toPixels) const {
+	const glm::mat2x3 linear = glm::mat2x3(glm::vec3(toPixels[0][0], toPixels[1][0], toPixels[2][0]),
+		glm::vec3(toPixels[0][1], toPixels[1][1], toPixels[2][1]));
+	float maxSquared = 0;
+	glm::vec3 previous(0), current(0);
+	for (int i = 0; i < count; i++) {
+		glm::vec3 next(x[i], y[i], z[i]);
+		if (rational) {
+			next /= w[i];
+		}
+		if (i >= 2) {
+			const glm::vec3 difference = previous - 2.0f * current + next;
+			const glm::vec2 pixels(glm::dot(linear[0], difference), glm::dot(linear[1], difference));
+			maxSquared = std::max(maxSquared, glm::dot(pixels, pixels));
+		}
+		previous = current;
+		current = next;
+	}
+	return secondDifferenceBound(degree) * std::sqrt(maxSquared);
+}
+
+// Vertex i of the polygon belongs to the average of knots i + 1 to i + degree,
+// the ones before the start of the domain are replaced by the curve's start
+void SubdivisionRefiner::vertices(const Curve& curve, std::vector<glm::vec3>& vertices, std::pmr::memory_resource* scratch) const {
+	vertices.clear();
+	const int n = (int)curve.controlPoints.size();
+	if (count == 0 || n < curve.order) {
+		return;
+	}
+	const int skip = (degree + 1) / 2;
+	vertices.reserve(count - 2 * skip + 2);
+	vertices.push_back(curve.evaluate(curve.order - 1, curve.knots[curve.order - 1], scratch));
+	for (int i = skip; i < count - skip; i++) {
+		glm::vec3 point(x[i], y[i], z[i]);
+		vertices.push_back(rational ? point / w[i] : point);
+	}
+	vertices.push_back(curve.evaluate(n - 1, curve.knots[n], scratch));
+}
+
+// The vertices of both polylines the benchmark measures are spread evenly
+// over the domain, so the nearest segment of a sample is searched for
+// around the one at the same fraction of the domain
+float SubdivisionRefiner::polylineError(const Curve& curve, const std::vector<glm::vec3>& polyline, int samplesPerSpan, std::pmr::memory_resource* scratch) {
+	if (polyline.size() < 2) {
+		return std::numeric_limits<float>::infinity();
+	}
+	const int segments = (int)polyline.size() - 1;
+	const int firstSpan = curve.order - 1;
+	const int spans = (int)curve.controlPoints.size() - firstSpan;
+	const int window = 4 + segments / std::max(spans * samplesPerSpan, 1);
+	float error = 0;
+	for (int span = 0; span < spans; span++) {
+		const int delta = firstSpan + span;
+		const float low = curve.knots[delta];
+		const float high = curve.knots[delta + 1];
+		for (int k = 0; k <= samplesPerSpan; k++) {
+			const glm::vec3 point = curve.evaluate(delta, low + (high - low) * k / samplesPerSpan, scratch);
+			const int expected = (int)((span + (float)k / samplesPerSpan) / spans * segments);
+			float nearest = std::numeric_limits<float>::max();
+			for (int s = std::max(expected - window, 0); s < std::min(expected + window + 1, segments); s++) {
+				const glm::vec3 edge = polyline[s + 1] - polyline[s];
+				const float length = glm::dot(edge, edge);
+				const float t = length > 0 ? glm::clamp(glm::dot(point - polyline[s], edge) / length, 0.0f, 1.0f) : 0.0f;
+				nearest = std::min(nearest, glm::distance(point, polyline[s] + t * edge));
+			}
+			error = std::max(error, nearest);
+		}
+	}
+	return error;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <memory_resource>
+#include <vector>
+
+#include "Curve.h"
+
+// Lane-Riesenfeld subdivision of a curve with uniform knots. A round doubles
+// every control point and then averages neighbours degree times, which gives
+// the control polygon of the same curve with twice the spans. The polygon
+// closes in on the curve quickly, so after a few rounds it can be drawn as
+// it is. The coordinates are kept as separate arrays and every pass is a
+// plain loop over them; the rounds work in place in storage kept between
+// calls, so refining every frame allocates nothing once it has grown.
+class SubdivisionRefiner {
+
+public:
+	float pixelTolerance = 0.5f;
+	int maxRounds = 10;
+	int rounds = 0;           // rounds the last refine ran
+	float polygonError = 0;   // pixel bound on the distance to the curve after the last refine
+
+	// Subdivides until the polygon is within pixelTolerance of the curve
+	// once mapped by toPixels, which must be affine, or maxRounds is reached.
+	// The curve must have uniform knots.
+	void refine(const Curve& curve, const glm::mat4& toPixels);
+	// The refined polygon trimmed to the domain, with the exact end points of the curve
+	void vertices(const Curve& curve, std::vector<glm::vec3>& vertices, std::pmr::memory_resource* scratch) const;
+
+	int pointCount() const { return count; }
+
+	// Largest distance from the curve to a polyline with vertices evenly
+	// spread over its domain, from samplesPerSpan points of every span
+	static float polylineError(const Curve& curve, const std::vector<glm::vec3>& polyline, int samplesPerSpan, std::pmr::memory_resource* scratch);
+
+private:
+	int degree = 0;
+	int count = 0;
+	bool rational = false;
+	std::vector<float> x, y, z, w; // homogeneous when rational, w unused otherwise
+
+	void subdivide();
+	float flatness(const glm::mat4& toPixels) const;
+};
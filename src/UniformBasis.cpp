@@ -0,0 +1,110 @@
+#include "UniformBasis.h"
+
+#include <memory_resource>
+
+namespace {
+
+// The Taylor expansion of the basis functions at the start of a span of
+// integer knots gives the rows, the derivatives come from the same basis
+// code the general path uses
+UniformBasis createBasis(int order) {
+	UniformBasis basis;
+	basis.order = order;
+	Curve unit;
+	unit.order = order;
+	unit.controlPoints.assign(order, glm::vec3(0));
+	unit.weights.assign(order, 1.0f);
+	for (int i = 0; i < 2 * order; i++) {
+		unit.knots.push_back((float)i);
+	}
+	std::vector<float> derivatives(order * order);
+	unit.basisDerivatives(order - 1, (float)(order - 1), order - 1, derivatives.data(), std::pmr::new_delete_resource());
+	basis.matrix.resize(order * order);
+	float factorial = 1;
+	for (int i = 0; i < order; i++) {
+		if (i > 0) {
+			factorial *= i;
+		}
+		for (int j = 0; j < order; j++) {
+			basis.matrix[i * order + j] = derivatives[i * order + j] / factorial;
+		}
+	}
+	return basis;
+}
+
+}
+
+const UniformBasis* UniformBasis::forOrder(int order) {
+	static const std::vector<UniformBasis> bases = [] {
+		std::vector<UniformBasis> result(maxUniformOrder + 1);
+		for (int order = 2; order <= maxUniformOrder; order++) {
+			result[order] = createBasis(order);
+		}
+		return result;
+	}();
+	return order >= 2 && order <= maxUniformOrder ? &bases[order] : nullptr;
+}
+
+void UniformBasis::blend(float t, float* weights) const {
+	for (int j = 0; j < order; j++) {
+		weights[j] = matrix[(order - 1) * order + j];
+	}
+	for (int i = order - 2; i >= 0; i--) {
+		for (int j = 0; j < order; j++) {
+			weights[j] = weights[j] * t + matrix[i * order + j];
+		}
+	}
+}
+
+glm::vec3 UniformBasis::evaluate(const Curve& curve, int delta, float uValue) const {
+	const int first = delta - order + 1;
+	const float low = curve.knots[delta];
+	float weights[maxUniformOrder];
+	blend((uValue - low) / (curve.knots[delta + 1] - low), weights);
+	glm::vec4 point = glm::vec4(0);
+	for (int j = 0; j < order; j++) {
+		const float weight = curve.weights[first + j];
+		point += weights[j] * glm::vec4(curve.controlPoints[first + j] * weight, weight);
+	}
+	return glm::vec3(point) / point.w;
+}
+
+void UniformBasis::spanCoefficients(const Curve& curve, int delta, glm::vec4* coefficients) const {
+	const int first = delta - order + 1;
+	for (int i = 0; i < order; i++) {
+		coefficients[i] = glm::vec4(0);
+	}
+	for (int j = 0; j < order; j++) {
+		const float weight = curve.weights[first + j];
+		const glm::vec4 point = glm::vec4(curve.controlPoints[first + j] * weight, weight);
+		for (int i = 0; i < order; i++) {
+			coefficients[i] += matrix[i * order + j] * point;
+		}
+	}
+}
+
+glm::vec3 UniformBasis::evaluateCoefficients(const glm::vec4* coefficients, float t) const {
+	glm::vec4 point = coefficients[order - 1];
+	for (int i = order - 2; i >= 0; i--) {
+		point = point * t + coefficients[i];
+	}
+	return glm::vec3(point) / point.w;
+}
+
+void UniformBasis::evaluateSpan(const Curve& curve, int delta, int samples, glm::vec3* points) const {
+	glm::vec4 coefficients[maxUniformOrder];
+	spanCoefficients(curve, delta, coefficients);
+	for (int s = 0; s <= samples; s++) {
+		points[s] = evaluateCoefficients(coefficients, (float)s / samples);
+	}
+}
+
+void UniformBasis::evaluateSpan(const Curve& curve, int delta, const float* parameters, int count, glm::vec3* points) const {
+	glm::vec4 coefficients[maxUniformOrder];
+	spanCoefficients(curve, delta, coefficients);
+	const float low = curve.knots[delta];
+	const float inverseWidth = 1.0f / (curve.knots[delta + 1] - low);
+	for (int s = 0; s < count; s++) {
+		points[s] = evaluateCoefficients(coefficients, (parameters[s] - low) * inverseWidth);
+	}
+}
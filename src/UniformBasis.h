@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Curve.h"
+
+const int maxUniformOrder = 8;
+
+// Basis functions of a uniform B-spline in power form. All spans of one
+// order share them: with t the position within span delta, the points of
+// the span blend as [1 t t^2 ...] matrix P, which takes the place of the de
+// Boor recursion and its knot differences. Only the parameter needs the
+// span start, and a whole span needs no knots at all.
+class UniformBasis {
+
+public:
+	// Shared tables for orders 2 to maxUniformOrder, nullptr for the others
+	static const UniformBasis* forOrder(int order);
+
+	int order = 0;
+	std::vector<float> matrix; // row i holds the coefficients of t^i
+
+	// Weights of the order points of a span at t in [0, 1]
+	void blend(float t, float* weights) const;
+	// Point of a curve with uniform knots at uValue in span delta
+	glm::vec3 evaluate(const Curve& curve, int delta, float uValue) const;
+	// Several points of one span share a single pass of the span's points
+	// through the matrix, every point is then Horner's rule in t
+	void spanCoefficients(const Curve& curve, int delta, glm::vec4* coefficients) const;
+	glm::vec3 evaluateCoefficients(const glm::vec4* coefficients, float t) const;
+	// samples + 1 points evenly over span delta
+	void evaluateSpan(const Curve& curve, int delta, int samples, glm::vec3* points) const;
+	// Points of span delta at count parameters
+	void evaluateSpan(const Curve& curve, int delta, const float* parameters, int count, glm::vec3* points) const;
+};